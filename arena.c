@@ -0,0 +1,252 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+
+#include "arena.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define ARENA_MMAP 1
+#else
+#define ARENA_MMAP 0
+#endif
+
+#define ALIGNMENT      16
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+#define ALIGN(size, alignment) \
+	(((size) + (alignment) - 1) & ~((size_t)(alignment) - 1))
+
+struct json_arena_block {
+	struct json_arena_block *next;
+	size_t size;
+	size_t used;
+	size_t mapped;
+	char *data;
+};
+
+#define HEADER_SIZE ALIGN(sizeof(struct json_arena_block), ALIGNMENT)
+
+#if ARENA_MMAP
+static void *map_block(size_t size, int huge)
+{
+	if (!huge) {
+		void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return mem == MAP_FAILED ? NULL : mem;
+	}
+
+	/* Over-allocate, so the mapping can be trimmed to an aligned one. */
+	size_t total = size + HUGE_PAGE_SIZE;
+	char *mem = mmap(NULL, total, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	char *aligned = (char *)ALIGN((uintptr_t)mem, HUGE_PAGE_SIZE);
+	size_t head = aligned - mem;
+	size_t tail = total - head - size;
+	if (head)
+		munmap(mem, head);
+	if (tail)
+		munmap(aligned + size, tail);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	return aligned;
+}
+#endif
+
+static struct json_arena_block *block_new(struct json_arena *arena,
+					  size_t size)
+{
+	struct json_arena_block *block;
+	size_t total = HEADER_SIZE + size;
+
+#if ARENA_MMAP
+	if (arena->flags & (JSON_ARENA_MMAP | JSON_ARENA_HUGEPAGES)) {
+		int huge = arena->flags & JSON_ARENA_HUGEPAGES;
+		total = ALIGN(total, huge ? HUGE_PAGE_SIZE : 4096);
+		block = map_block(total, huge);
+		if (!block)
+			return NULL;
+		block->mapped = total;
+	}
+	else
+#endif
+	{
+		block = malloc(total);
+		if (!block)
+			return NULL;
+		block->mapped = 0;
+	}
+
+	block->data = (char *)block + HEADER_SIZE;
+	block->size = total - HEADER_SIZE;
+	block->used = 0;
+	block->next = NULL;
+	return block;
+}
+
+static void block_free(struct json_arena_block *block)
+{
+#if ARENA_MMAP
+	if (block->mapped) {
+		munmap(block, block->mapped);
+		return;
+	}
+#endif
+	free(block);
+}
+
+struct json_arena *json_arena_new(size_t block_size, unsigned int flags)
+{
+	struct json_arena *arena = malloc(sizeof(struct json_arena));
+	if (!arena)
+		return NULL;
+
+	if (!block_size)
+		block_size = flags & JSON_ARENA_HUGEPAGES ?
+			HUGE_PAGE_SIZE - HEADER_SIZE : JSON_ARENA_BLOCK_SIZE;
+
+	arena->flags = flags;
+	arena->block_size = block_size;
+	arena->blocks = NULL;
+	arena->first = NULL;
+	arena->last = NULL;
+	return arena;
+}
+
+void json_arena_free(struct json_arena *arena)
+{
+	struct json_arena_block *block = arena->blocks;
+	while (block) {
+		struct json_arena_block *next = block->next;
+		block_free(block);
+		block = next;
+	}
+	free(arena);
+}
+
+void json_arena_reset(struct json_arena *arena)
+{
+	struct json_arena_block *first = arena->first;
+	struct json_arena_block *block = arena->blocks;
+	if (!block)
+		return;
+
+	/* Large blocks of their own may be anywhere in the list, even at
+	   its end, so the first regular block is looked up by pointer. */
+	while (block) {
+		struct json_arena_block *next = block->next;
+		if (block != first)
+			block_free(block);
+		block = next;
+	}
+	first->used = 0;
+	first->next = NULL;
+	arena->blocks = first;
+	arena->last = NULL;
+}
+
+void json_arena_merge(struct json_arena *arena, struct json_arena *other)
+{
+	struct json_arena_block *first = other->blocks;
+	if (!first)
+		return;
+
+	/* Keep allocating from the current block. The blocks of [other]
+	   go behind it and are released on the next reset. */
+	struct json_arena_block *last = first;
+	while (last->next)
+		last = last->next;
+	if (arena->blocks) {
+		last->next = arena->blocks->next;
+		arena->blocks->next = first;
+	}
+	else {
+		arena->blocks = first;
+		arena->first = other->first;
+		arena->last = other->last;
+	}
+
+	other->blocks = NULL;
+	other->first = NULL;
+	other->last = NULL;
+}
+
+void *json_arena_alloc(struct json_arena *arena, size_t size)
+{
+	struct json_arena_block *block = arena->blocks;
+	size = ALIGN(size ? size : 1, ALIGNMENT);
+
+	if (block && block->size - block->used >= size) {
+		void *mem = block->data + block->used;
+		block->used += size;
+		arena->last = mem;
+		return mem;
+	}
+
+	/* Large allocations get a block of their own, which is put behind
+	   the current one, so its remaining space is not given up. */
+	if (block && size > arena->block_size / 4) {
+		struct json_arena_block *own = block_new(arena, size);
+		if (!own)
+			return NULL;
+		own->used = size;
+		own->next = block->next;
+		block->next = own;
+		return own->data;
+	}
+
+	/* Blocks double in size, so large documents need only a few. */
+	size_t block_size = arena->block_size;
+	if (block && block->size < MAX_BLOCK_SIZE)
+		block_size = block->size << 1;
+	else if (block)
+		block_size = block->size;
+
+	block = block_new(arena, size > block_size ? size : block_size);
+	if (!block)
+		return NULL;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	if (!arena->first)
+		arena->first = block;
+
+	block->used = size;
+	arena->last = block->data;
+	return block->data;
+}
+
+void *json_arena_realloc(struct json_arena *arena, void *ptr,
+			 size_t old_size, size_t size)
+{
+	if (!ptr)
+		return json_arena_alloc(arena, size);
+
+	struct json_arena_block *block = arena->blocks;
+	if (ptr == arena->last) {
+		size_t offset = (char *)ptr - block->data;
+		size_t aligned = ALIGN(size ? size : 1, ALIGNMENT);
+		if (block->size - offset >= aligned) {
+			block->used = offset + aligned;
+			return ptr;
+		}
+	}
+
+	if (size <= old_size)
+		return ptr;
+
+	void *mem = json_arena_alloc(arena, size);
+	if (!mem)
+		return NULL;
+	return memcpy(mem, ptr, old_size);
+}
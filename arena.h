@@ -0,0 +1,105 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_ARENA_H
+#define JONSON_ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Back the blocks of the arena with anonymous memory mappings instead of
+ * malloc(). With JSON_ARENA_HUGEPAGES the mappings are aligned to and
+ * advised for transparent huge pages, where the system supports them.
+ */
+#define JSON_ARENA_MMAP      0x1
+#define JSON_ARENA_HUGEPAGES 0x2
+
+#define JSON_ARENA_BLOCK_SIZE (64 * 1024)
+
+struct json_arena_block;
+
+/*
+ * A bump allocator. Memory is handed out from large blocks and can only
+ * be released all at once, by resetting or freeing the arena.
+ */
+struct json_arena {
+	unsigned int flags;
+	size_t block_size;
+	struct json_arena_block *blocks;
+	struct json_arena_block *first; /* Kept by json_arena_reset() */
+	void *last;
+};
+
+/*
+ * Creates an arena whose blocks are [block_size] bytes large, or
+ * JSON_ARENA_BLOCK_SIZE if it is 0. Returns NULL on failure.
+ */
+struct json_arena *json_arena_new(size_t block_size, unsigned int flags);
+
+void json_arena_free(struct json_arena *arena);
+
+/*
+ * Releases all allocations at once. The first regular block is kept for
+ * reuse, blocks that were grown or given to large allocations are not.
+ */
+void json_arena_reset(struct json_arena *arena);
+
+/*
+ * Moves all memory of [other] into [arena], so allocations from both
+ * are released together. [other] is left empty and can still be used
+ * or freed.
+ */
+void json_arena_merge(struct json_arena *arena, struct json_arena *other);
+
+/*
+ * Returns [size] bytes of memory, aligned for any built-in type,
+ * or NULL if no more memory is available.
+ */
+void *json_arena_alloc(struct json_arena *arena, size_t size);
+
+/*
+ * Grows or shrinks an allocation. It is resized in place if it is the
+ * most recent one, otherwise it is copied and the old memory stays
+ * unused until the arena is reset.
+ */
+void *json_arena_realloc(struct json_arena *arena, void *ptr,
+			 size_t old_size, size_t size);
+
+static inline char *json_arena_strndup(struct json_arena *arena,
+				       const char *str, size_t size)
+{
+	char *copy = json_arena_alloc(arena, size + 1);
+	if (!copy)
+		return NULL;
+	copy[size] = 0;
+	return memcpy(copy, str, size);
+}
+
+/*
+ * Allocation helpers for containers that either live within an arena
+ * or on the heap, if [arena] is NULL.
+ */
+static inline void *json_alloc(struct json_arena *arena, size_t size)
+{
+	return arena ? json_arena_alloc(arena, size) : malloc(size);
+}
+
+static inline void *json_realloc(struct json_arena *arena, void *ptr,
+				 size_t old_size, size_t size)
+{
+	return arena ? json_arena_realloc(arena, ptr, old_size, size)
+		: realloc(ptr, size);
+}
+
+static inline void json_dealloc(struct json_arena *arena, void *ptr)
+{
+	if (!arena)
+		free(ptr);
+}
+
+#endif /* JONSON_ARENA_H */
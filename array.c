@@ -10,26 +10,35 @@
 
 struct json_array *json_array_new(void)
 {
-	struct json_array *array = malloc(sizeof(struct json_array));
+	return json_array_new_in(NULL);
+}
+
+struct json_array *json_array_new_in(struct json_arena *arena)
+{
+	struct json_array *array = json_alloc(arena, sizeof(struct json_array));
 	if (!array)
 		goto error_array;
 
+	array->arena = arena;
 	array->size = 0;
 	array->capacity = INIT_CAPACITY;
-	array->data = malloc(array->capacity * sizeof(struct json));
+	array->data = json_alloc(arena, array->capacity * sizeof(struct json));
 	if (!array->data)
 		goto error_data;
 
 	return array;
 
 error_data:
-	free(array);
+	json_dealloc(arena, array);
 error_array:
 	return NULL;
 }
 
 void json_array_free(struct json_array *array)
 {
+	if (array->arena)
+		return;
+
 	for (size_t i = 0; i < array->size; ++i)
 		json_free(array->data[i]);
 	free(array->data);
@@ -39,10 +48,13 @@ void json_array_free(struct json_array *array)
 int json_array_reserve(struct json_array *array, size_t size)
 {
 	if (size > array->capacity) {
-		array->capacity = size;
-		array->data = realloc(array->data, size * sizeof(struct json));
-		if (!array->data)
+		struct json *data = json_realloc(array->arena, array->data,
+			array->capacity * sizeof(struct json),
+			size * sizeof(struct json));
+		if (!data)
 			return 0;
+		array->data = data;
+		array->capacity = size;
 	}
 	return 1;
 }
@@ -56,8 +68,9 @@ int json_array_resize(struct json_array *array, size_t size)
 
 	struct json *end = array->data + size;
 	size_t end_size = array->size - size;
-	for (size_t i = 0; i < end_size; ++i)
-		json_free(end[i]);
+	if (!array->arena)
+		for (size_t i = 0; i < end_size; ++i)
+			json_free(end[i]);
 	array->size = size;
 
 	return 1;
@@ -66,8 +79,9 @@ int json_array_resize(struct json_array *array, size_t size)
 int json_array_add(struct json_array *array, struct json value)
 {
 	if (array->size >= array->capacity)
-		return json_array_reserve(array, array->capacity << 1);
-	
+		if (!json_array_reserve(array, array->capacity << 1))
+			return 0;
+
 	array->data[array->size++] = value;
 	return 1;
 }
@@ -8,8 +8,10 @@
 #define JONSON_ARRAY_H
 
 #include "jonson.h"
+#include "arena.h"
 
 struct json_array {
+	struct json_arena *arena;
 	size_t capacity;
 	size_t size;
 	struct json *data;
@@ -17,6 +19,14 @@ struct json_array {
 
 struct json_array *json_array_new(void);
 
+/*
+ * Creates an array that allocates itself and its storage within
+ * [arena]. It is released together with the arena, json_array_free()
+ * does nothing for it. Its values are expected to belong to the same
+ * arena and are not freed either.
+ */
+struct json_array *json_array_new_in(struct json_arena *arena);
+
 void json_array_free(struct json_array *array);
 
 int json_array_reserve(struct json_array *array, size_t size);
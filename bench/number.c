@@ -0,0 +1,140 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/*
+ * Times json_number_format() against the snprintf("%.16g") path it
+ * replaced, on the same inputs, and checks that every formatted number
+ * reads back as the same double.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "number.h"
+
+#define COUNT  2000000
+#define ROUNDS 3
+
+static uint64_t state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t next_random(void)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/* Finite doubles with uniformly random bit patterns. */
+static double random_bits(void)
+{
+	for (;;) {
+		uint64_t bits = next_random();
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		if (value == value && value - value == 0)
+			return value;
+	}
+}
+
+/* Integers, as ids and counters are. */
+static double random_integer(void)
+{
+	return (double)(next_random() % 100000000);
+}
+
+/* Values with two decimals, as prices and measurements are. */
+static double random_decimal(void)
+{
+	return (double)(next_random() % 1000000) / 100;
+}
+
+static size_t format_snprintf(double value, char *buf)
+{
+	return (size_t)snprintf(buf, JSON_NUMBER_MAX_SIZE, "%.16g", value);
+}
+
+static double seconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Returns the fastest of a few rounds over [values] in nanoseconds per
+ * number. The total length is kept so the calls cannot be dropped.
+ */
+static double time_format(const double *values,
+			  size_t (*format)(double, char *), size_t *total)
+{
+	char buf[JSON_NUMBER_MAX_SIZE];
+	double best = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		clock_t start = clock();
+		for (size_t i = 0; i < COUNT; ++i)
+			*total += format(values[i], buf);
+		double elapsed = seconds(start);
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best * 1e9 / COUNT;
+}
+
+/* Returns the number of values that do not read back exactly. */
+static size_t check_round_trip(const double *values)
+{
+	char buf[JSON_NUMBER_MAX_SIZE + 1];
+	size_t failed = 0;
+
+	for (size_t i = 0; i < COUNT; ++i) {
+		buf[json_number_format(values[i], buf)] = 0;
+		if (strtod(buf, NULL) != values[i])
+			++failed;
+	}
+	return failed;
+}
+
+int main(void)
+{
+	static const struct {
+		const char *name;
+		double (*generate)(void);
+	} inputs[] = {
+		{ "random bits", random_bits },
+		{ "integers", random_integer },
+		{ "two decimals", random_decimal }
+	};
+
+	double *values = malloc(COUNT * sizeof(double));
+	if (!values)
+		return EXIT_FAILURE;
+
+	size_t total = 0;
+	int status = EXIT_SUCCESS;
+	printf("%-14s %12s %12s %8s\n", "input", "snprintf", "jonson", "speedup");
+	for (size_t j = 0; j < sizeof(inputs) / sizeof(inputs[0]); ++j) {
+		for (size_t i = 0; i < COUNT; ++i)
+			values[i] = inputs[j].generate();
+
+		double old = time_format(values, format_snprintf, &total);
+		double new = time_format(values, json_number_format, &total);
+		printf("%-14s %9.1f ns %9.1f ns %7.1fx\n",
+		       inputs[j].name, old, new, old / new);
+
+		size_t failed = check_round_trip(values);
+		if (failed) {
+			printf("%zu numbers did not round-trip\n", failed);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	/* Printed so the timed calls have an observable result. */
+	printf("%zu characters written\n", total);
+	free(values);
+	return status;
+}
@@ -0,0 +1,370 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cursor.h"
+#include "escape.h"
+#include "number.h"
+#include "parse.h"
+#include "token.h"
+
+/* Keys up to this size are decoded on the stack for comparison. */
+#define KEY_BUFFER_SIZE 128
+
+static inline size_t skip_whitespace(const char *data, size_t size,
+				     size_t position)
+{
+	return position + json_token_whitespace(data + position,
+						size - position);
+}
+
+/*
+ * Returns the offset past the quotation mark that closes the string
+ * starting at [position], or 0 if it is not closed or contains a
+ * control character. Sets [escaped] if it has escape sequences.
+ */
+static size_t skip_string(const char *data, size_t size, size_t position,
+			  int *escaped)
+{
+	size_t i = position + 1;
+	while (i < size) {
+		i += json_escape_scan(data + i, size - i);
+		if (i == size || (unsigned char)data[i] < 0x20)
+			return 0;
+		if (data[i] == '"')
+			return i + 1;
+		/* A backslash, skip it and the character it escapes. */
+		*escaped = 1;
+		i += 2;
+	}
+	return 0;
+}
+
+/* Characters that matter when skipping over an object or array. */
+static const unsigned char brackets[256] = {
+	['"'] = 1, ['{'] = 1, ['}'] = 1, ['['] = 1, [']'] = 1
+};
+
+/*
+ * Returns the offset past the quotation mark that closes the string
+ * starting at [position], or 0 if it is not closed. Used to skip
+ * strings, so it does not look for control characters.
+ */
+static size_t skip_quoted(const char *data, size_t size, size_t position)
+{
+	size_t i = position + 1;
+	for (;;) {
+		const char *quote = memchr(data + i, '"', size - i);
+		if (!quote)
+			return 0;
+		i = quote - data;
+		/* Escaped if preceded by an odd number of backslashes. */
+		size_t backslashes = 0;
+		while (data[i - 1 - backslashes] == '\\')
+			++backslashes;
+		if (!(backslashes & 1))
+			return i + 1;
+		++i;
+	}
+}
+
+/*
+ * Returns the offset past the value starting at [position], or 0 if it
+ * does not end. Of objects and arrays only the brackets and strings
+ * are looked at.
+ */
+static size_t skip_value(const char *data, size_t size, size_t position)
+{
+	size_t depth = 0;
+	size_t i = position;
+
+	switch (data[i]) {
+	case '"':
+		return skip_quoted(data, size, i);
+	case '{':
+	case '[':
+		break;
+	default:
+		while (i < size) {
+			switch (data[i]) {
+			case ',':
+			case '}':
+			case ']':
+			case TOKEN_SPACE:
+			case TOKEN_CARRIAGE_RETURN:
+			case TOKEN_LINE_FEED:
+			case TOKEN_HORIZONTAL_TAB:
+				return i > position ? i : 0;
+			}
+			++i;
+		}
+		return i > position ? i : 0;
+	}
+
+	while (i < size) {
+		if (!brackets[(unsigned char)data[i]]) {
+			++i;
+			continue;
+		}
+		switch (data[i]) {
+		case '"':
+			i = skip_quoted(data, size, i);
+			if (!i)
+				return 0;
+			continue;
+		case '{':
+		case '[':
+			++depth;
+			break;
+		default:
+			if (--depth == 0)
+				return i + 1;
+			break;
+		}
+		++i;
+	}
+	return 0;
+}
+
+static int key_equals(const char *data, size_t size, int escaped,
+		      const char *key, size_t key_size)
+{
+	if (!escaped)
+		return size == key_size && !memcmp(data, key, size);
+	/* Escape sequences only ever shrink a key. */
+	if (size < key_size)
+		return 0;
+
+	char buffer[KEY_BUFFER_SIZE];
+	char *decoded = size <= KEY_BUFFER_SIZE ? buffer : malloc(size);
+	if (!decoded)
+		return 0;
+	size = json_unescape_n(decoded, data, size);
+	int equal = size == key_size && !memcmp(decoded, key, size);
+	if (decoded != buffer)
+		free(decoded);
+	return equal;
+}
+
+static void cursor_at(struct json_cursor *value,
+		      const struct json_cursor *container,
+		      size_t start, size_t end)
+{
+	value->data = container->data;
+	value->size = container->size;
+	value->start = start;
+	value->end = end;
+	value->next = 0;
+	value->index = 0;
+}
+
+/*
+ * Moves past the separator that follows a member ending at [position].
+ * Returns the offset of the next member, that of the closing bracket
+ * if there is none, or 0 if neither follows.
+ */
+static size_t next_member(const char *data, size_t size, size_t position,
+			  char end)
+{
+	position = skip_whitespace(data, size, position);
+	if (position == size)
+		return 0;
+	if (data[position] == ',')
+		return position + 1;
+	return data[position] == end ? position : 0;
+}
+
+enum json_type json_cursor_init_n(struct json_cursor *cursor,
+				  const char *data, size_t size)
+{
+	cursor->data = data;
+	cursor->size = size;
+	cursor->start = skip_whitespace(data, size, 0);
+	cursor->end = 0;
+	cursor->next = 0;
+	cursor->index = 0;
+	return json_cursor_type(cursor);
+}
+
+enum json_type json_cursor_type(const struct json_cursor *cursor)
+{
+	if (cursor->start >= cursor->size)
+		return JSON_TYPE_NONE;
+
+	switch (cursor->data[cursor->start]) {
+	case '{':
+		return JSON_TYPE_OBJECT;
+	case '[':
+		return JSON_TYPE_ARRAY;
+	case '"':
+		return JSON_TYPE_STRING;
+	case 't':
+	case 'f':
+		return JSON_TYPE_BOOLEAN;
+	case 'n':
+		return JSON_TYPE_NULL;
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+		return JSON_TYPE_NUMBER;
+	default:
+		return JSON_TYPE_NONE;
+	}
+}
+
+enum json_type json_cursor_object_get_n(struct json_cursor *object,
+					const char *key, size_t size,
+					struct json_cursor *value)
+{
+	if (json_cursor_type(object) != JSON_TYPE_OBJECT)
+		return JSON_TYPE_NONE;
+
+	const char *data = object->data;
+	size_t first = object->start + 1;
+	size_t position = object->next ? object->next : first;
+	size_t stop = object->next ? object->next : object->size;
+	int wrapped = !object->next;
+
+	for (;;) {
+		position = skip_whitespace(data, object->size, position);
+		if (position == object->size)
+			return JSON_TYPE_NONE;
+
+		if (data[position] == '}') {
+			if (wrapped)
+				return JSON_TYPE_NONE;
+			position = first;
+			wrapped = 1;
+			continue;
+		}
+
+		int escaped = 0;
+		size_t key_start = position + 1;
+		size_t key_end = data[position] == '"' ?
+			skip_string(data, object->size, position, &escaped) : 0;
+		if (!key_end)
+			return JSON_TYPE_NONE;
+
+		position = skip_whitespace(data, object->size, key_end);
+		if (position == object->size || data[position] != ':')
+			return JSON_TYPE_NONE;
+		size_t start = skip_whitespace(data, object->size, position + 1);
+		if (start == object->size)
+			return JSON_TYPE_NONE;
+		size_t end = skip_value(data, object->size, start);
+		if (!end)
+			return JSON_TYPE_NONE;
+		position = next_member(data, object->size, end, '}');
+		if (!position)
+			return JSON_TYPE_NONE;
+
+		if (key_equals(data + key_start, key_end - key_start - 1,
+			       escaped, key, size)) {
+			object->next = position;
+			cursor_at(value, object, start, end);
+			return json_cursor_type(value);
+		}
+		if (wrapped && position >= stop)
+			return JSON_TYPE_NONE;
+	}
+}
+
+enum json_type json_cursor_array_get(struct json_cursor *array,
+				     size_t index, struct json_cursor *value)
+{
+	if (json_cursor_type(array) != JSON_TYPE_ARRAY)
+		return JSON_TYPE_NONE;
+
+	const char *data = array->data;
+	size_t position = array->next;
+	size_t current = array->index;
+
+	/* Elements can only be counted from the front. */
+	if (!position || index < current) {
+		position = array->start + 1;
+		current = 0;
+	}
+
+	for (;; ++current) {
+		position = skip_whitespace(data, array->size, position);
+		if (position == array->size || data[position] == ']')
+			return JSON_TYPE_NONE;
+
+		size_t start = position;
+		size_t end = skip_value(data, array->size, start);
+		if (!end)
+			return JSON_TYPE_NONE;
+		position = next_member(data, array->size, end, ']');
+		if (!position)
+			return JSON_TYPE_NONE;
+
+		if (current == index) {
+			array->next = position;
+			array->index = current + 1;
+			cursor_at(value, array, start, end);
+			return json_cursor_type(value);
+		}
+	}
+}
+
+struct json json_cursor_value(struct json_cursor *cursor)
+{
+	const char *data = cursor->data + cursor->start;
+
+	if (!cursor->end) {
+		if (json_cursor_type(cursor) == JSON_TYPE_NONE)
+			return JSON_NONE;
+		cursor->end = skip_value(cursor->data, cursor->size,
+					 cursor->start);
+		if (!cursor->end)
+			return JSON_NONE;
+	}
+	size_t length = cursor->end - cursor->start;
+
+	switch (json_cursor_type(cursor)) {
+	case JSON_TYPE_STRING: {
+		/* Without the quotation marks. */
+		length -= 2;
+		char *string = malloc(length + 1);
+		if (!string)
+			return JSON_NONE;
+		if (memchr(data + 1, '\\', length)) {
+			length = json_unescape_n(string, data + 1, length);
+			if (length == JSON_UNESCAPE_ERROR) {
+				free(string);
+				return JSON_NONE;
+			}
+		}
+		else
+			memcpy(string, data + 1, length);
+		string[length] = 0;
+		return JSON_STRP(string);
+	}
+	case JSON_TYPE_NUMBER: {
+		double number;
+		if (json_number_parse_n(data, length, &number) != length)
+			return JSON_NONE;
+		return JSON_NUM(number);
+	}
+	case JSON_TYPE_BOOLEAN:
+		if (length == TOKEN_TRUE_SIZE &&
+				!memcmp(data, TOKEN_TRUE, TOKEN_TRUE_SIZE))
+			return JSON_BOOL(1);
+		if (length == TOKEN_FALSE_SIZE &&
+				!memcmp(data, TOKEN_FALSE, TOKEN_FALSE_SIZE))
+			return JSON_BOOL(0);
+		return JSON_NONE;
+	case JSON_TYPE_NULL:
+		if (length == TOKEN_NULL_SIZE &&
+				!memcmp(data, TOKEN_NULL, TOKEN_NULL_SIZE))
+			return JSON_NULL;
+		return JSON_NONE;
+	default:
+		return json_parse_n(data, length);
+	}
+}
@@ -0,0 +1,74 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_CURSOR_H
+#define JONSON_CURSOR_H
+
+#include <stddef.h>
+
+#include "jonson.h"
+
+/*
+ * Refers to a value within JSON text that is held in memory, without
+ * parsing anything up front. Lookups scan the text from where the last
+ * one within the same container stopped, skip the values that are not
+ * asked for by only matching brackets and strings, and wrap around to
+ * the start of the container if necessary. Reading members in the order
+ * they appear in therefore goes over the text once.
+ *
+ * Only what is looked up or converted is validated. The text has to
+ * outlive all cursors into it.
+ */
+struct json_cursor {
+	const char *data;
+	size_t size;
+	size_t start; /* Offset of the value */
+	size_t end;   /* Offset past its end, 0 while unknown */
+	size_t next;  /* Member to continue a lookup at, 0 for the first */
+	size_t index; /* Array index of that member */
+};
+
+/*
+ * Points [cursor] at the value in [data], which may be surrounded by
+ * whitespace. Returns the type of the value, or JSON_TYPE_NONE if
+ * there is none.
+ */
+enum json_type json_cursor_init_n(struct json_cursor *cursor,
+				  const char *data, size_t size);
+#define json_cursor_init(cursor, data) \
+	json_cursor_init_n(cursor, data, (data) ? strlen(data) : 0)
+
+/*
+ * Returns the type of the value [cursor] points at, telling from its
+ * first character.
+ */
+enum json_type json_cursor_type(const struct json_cursor *cursor);
+
+/*
+ * Point [value] at the member of an object with the given [key] or the
+ * element of an array at [index]. Return its type, or JSON_TYPE_NONE
+ * if there is no such member or the text is malformed, in which case
+ * [value] is not changed. The container cursor remembers where to
+ * continue, so it is modified.
+ */
+enum json_type json_cursor_object_get_n(struct json_cursor *object,
+					const char *key, size_t size,
+					struct json_cursor *value);
+#define json_cursor_object_get(object, key, value) \
+	json_cursor_object_get_n(object, key, (key) ? strlen(key) : 0, value)
+
+enum json_type json_cursor_array_get(struct json_cursor *array,
+				     size_t index, struct json_cursor *value);
+
+/*
+ * Converts the value [cursor] points at. Strings are decoded into a
+ * copy, objects and arrays are parsed as a whole. The result has to be
+ * released with json_free(). Returns JSON_NONE if the value is
+ * malformed.
+ */
+struct json json_cursor_value(struct json_cursor *cursor);
+
+#endif /* JONSON_CURSOR_H */
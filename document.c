@@ -0,0 +1,61 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "document.h"
+#include "file.h"
+
+struct json_document *json_document_new(unsigned int flags)
+{
+	struct json_document *document = malloc(sizeof(struct json_document));
+	if (!document)
+		goto error_document;
+
+	document->arena = json_arena_new(0, flags);
+	if (!document->arena)
+		goto error_arena;
+
+	document->keys = NULL;
+	document->root = JSON_NONE;
+	document->input = NULL;
+	return document;
+
+error_arena:
+	free(document);
+error_document:
+	return NULL;
+}
+
+static void release_input(struct json_document *document)
+{
+	if (!document->input)
+		return;
+	json_file_close(document->input);
+	free(document->input);
+	document->input = NULL;
+}
+
+void json_document_free(struct json_document *document)
+{
+	release_input(document);
+	json_arena_free(document->arena);
+	if (document->keys)
+		json_intern_release(document->keys);
+	free(document);
+}
+
+int json_document_intern_keys(struct json_document *document)
+{
+	if (!document->keys)
+		document->keys = json_intern_new();
+	return document->keys != NULL;
+}
+
+void json_document_reset(struct json_document *document)
+{
+	json_arena_reset(document->arena);
+	document->root = JSON_NONE;
+	release_input(document);
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_DOCUMENT_H
+#define JONSON_DOCUMENT_H
+
+#include "jonson.h"
+#include "arena.h"
+
+struct json_file;
+
+/*
+ * A JSON value together with the arena all of its nodes are allocated
+ * in. Build values with the *_in() functions and macros, passing the
+ * document's arena, or let a [struct json_stream] parse into it.
+ * None of its values may be passed to json_free(), the whole tree is
+ * released at once with json_document_free() or json_document_reset().
+ */
+struct json_document {
+	struct json_arena *arena;
+	struct json_intern *keys;
+	struct json root;
+	struct json_file *input; /* Text the values borrow from, or NULL */
+};
+
+/*
+ * Creates an empty document. [flags] are passed on to json_arena_new(),
+ * e.g. JSON_ARENA_MMAP for large documents. Returns NULL on failure.
+ */
+struct json_document *json_document_new(unsigned int flags);
+
+void json_document_free(struct json_document *document);
+
+/*
+ * Creates a key intern pool for the objects of the document, unless it
+ * already has one. The pool is kept when the document is reset, so keys
+ * repeating across values are only copied once. Returns 0 on failure.
+ */
+int json_document_intern_keys(struct json_document *document);
+
+/*
+ * Drops the root and everything allocated within the document,
+ * keeping the memory for the next value. The input is released.
+ */
+void json_document_reset(struct json_document *document);
+
+#endif /* JONSON_DOCUMENT_H */
@@ -0,0 +1,255 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdint.h>
+
+#include "escape.h"
+#include "simd.h"
+
+#if JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define ONES  0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+
+static inline int needs_escape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+/*
+ * Portable kernel, tests eight bytes at a time. A word is flagged if one
+ * of its bytes is below 0x20 or equal to a quotation mark or a backslash,
+ * the exact position is then found byte by byte.
+ */
+static size_t scan_word(const char *str, size_t size)
+{
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, str + i, 8);
+		uint64_t quote = word ^ (ONES * '"');
+		uint64_t backslash = word ^ (ONES * '\\');
+		uint64_t flags = ((word - ONES * 0x20) & ~word) |
+			((quote - ONES) & ~quote) |
+			((backslash - ONES) & ~backslash);
+		if (flags & HIGHS)
+			break;
+	}
+	for (; i < size; ++i)
+		if (needs_escape(str[i]))
+			return i;
+	return size;
+}
+
+#if JSON_SIMD_X86
+JSON_TARGET("sse2")
+static size_t scan_sse2(const char *str, size_t size)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1f);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+				     _mm_cmpeq_epi8(v, backslash)),
+			_mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+		int mask = _mm_movemask_epi8(special);
+		if (mask)
+			return i + json_ctz32(mask);
+	}
+	return i + scan_word(str + i, size - i);
+}
+
+JSON_TARGET("avx2")
+static size_t scan_avx2(const char *str, size_t size)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i control = _mm256_set1_epi8(0x1f);
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+		__m256i special = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+					_mm256_cmpeq_epi8(v, backslash)),
+			_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+		unsigned int mask = _mm256_movemask_epi8(special);
+		if (mask)
+			return i + json_ctz32(mask);
+	}
+	return i + scan_sse2(str + i, size - i);
+}
+#endif
+
+static size_t scan_resolve(const char *str, size_t size);
+
+static size_t (*scan)(const char *, size_t) = scan_resolve;
+
+static size_t scan_resolve(const char *str, size_t size)
+{
+	switch (json_simd_level()) {
+#if JSON_SIMD_X86
+	case JSON_SIMD_AVX2: json_dispatch_store(scan, scan_avx2); break;
+	case JSON_SIMD_SSE42:
+	case JSON_SIMD_SSE2: json_dispatch_store(scan, scan_sse2); break;
+#endif
+	default: json_dispatch_store(scan, scan_word); break;
+	}
+	return json_escape_scan(str, size);
+}
+
+size_t json_escape_scan(const char *str, size_t size)
+{
+	return json_dispatch_load(scan)(str, size);
+}
+
+size_t json_escape_char(char *out, unsigned char c)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	out[0] = '\\';
+	switch (c) {
+	case '"':  out[1] = '"'; break;
+	case '\\': out[1] = '\\'; break;
+	case '\b': out[1] = 'b'; break;
+	case '\f': out[1] = 'f'; break;
+	case '\n': out[1] = 'n'; break;
+	case '\r': out[1] = 'r'; break;
+	case '\t': out[1] = 't'; break;
+	default:
+		memcpy(out + 1, "u00", 3);
+		out[4] = hex[c >> 4];
+		out[5] = hex[c & 0xf];
+		return 6;
+	}
+	return 2;
+}
+
+size_t json_escape_n(struct strbuffer *sb, const char *str, size_t size)
+{
+	size_t previous_size = sb->size;
+	size_t i = 0;
+
+	if (size == 0)
+		return 0;
+
+	/* The unescaped remainder of the string always fits. */
+	strbuffer_ensure(sb, size);
+
+	for (;;) {
+		size_t run = json_dispatch_load(scan)(str + i, size - i);
+		memcpy(sb->buffer + sb->size, str + i, run);
+		sb->size += run;
+		i += run;
+		if (i == size)
+			break;
+
+		strbuffer_ensure(sb, JSON_ESCAPE_MAX_SIZE + (size - i - 1));
+		sb->size += json_escape_char(sb->buffer + sb->size, str[i++]);
+	}
+
+	return sb->size - previous_size;
+}
+
+/*
+ * Reads four hexadecimal digits, returns -1 if one of them is not.
+ */
+static long read_hex4(const char *str)
+{
+	long value = 0;
+	for (int i = 0; i < 4; ++i) {
+		int digit = json_hex_digit(str[i]);
+		if (digit < 0)
+			return -1;
+		value = value << 4 | digit;
+	}
+	return value;
+}
+
+static size_t write_utf8(char *out, unsigned long code_point)
+{
+	if (code_point < 0x80) {
+		out[0] = (char)code_point;
+		return 1;
+	}
+	if (code_point < 0x800) {
+		out[0] = (char)(0xc0 | (code_point >> 6));
+		out[1] = (char)(0x80 | (code_point & 0x3f));
+		return 2;
+	}
+	if (code_point < 0x10000) {
+		out[0] = (char)(0xe0 | (code_point >> 12));
+		out[1] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (code_point & 0x3f));
+		return 3;
+	}
+	out[0] = (char)(0xf0 | (code_point >> 18));
+	out[1] = (char)(0x80 | ((code_point >> 12) & 0x3f));
+	out[2] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+	out[3] = (char)(0x80 | (code_point & 0x3f));
+	return 4;
+}
+
+size_t json_unescape_n(char *out, const char *str, size_t size)
+{
+	size_t written = 0;
+	size_t i = 0;
+
+	for (;;) {
+		const char *backslash = memchr(str + i, '\\', size - i);
+		size_t run = backslash ? (size_t)(backslash - str) - i : size - i;
+		memmove(out + written, str + i, run);
+		written += run;
+		i += run;
+		if (i == size)
+			return written;
+
+		if (++i == size)
+			return JSON_UNESCAPE_ERROR;
+		switch (str[i++]) {
+		case '"':  out[written++] = '"'; continue;
+		case '\\': out[written++] = '\\'; continue;
+		case '/':  out[written++] = '/'; continue;
+		case 'b':  out[written++] = '\b'; continue;
+		case 'f':  out[written++] = '\f'; continue;
+		case 'n':  out[written++] = '\n'; continue;
+		case 'r':  out[written++] = '\r'; continue;
+		case 't':  out[written++] = '\t'; continue;
+		case 'u':  break;
+		default:   return JSON_UNESCAPE_ERROR;
+		}
+
+		long code_point;
+		if (size - i < 4 || (code_point = read_hex4(str + i)) < 0)
+			return JSON_UNESCAPE_ERROR;
+		i += 4;
+
+		/* Owned strings are measured with strlen(), a NUL within
+		   one would cut it short. */
+		if (!code_point)
+			return JSON_UNESCAPE_ERROR;
+		if (code_point >= 0xdc00 && code_point <= 0xdfff)
+			return JSON_UNESCAPE_ERROR;
+		if (code_point >= 0xd800 && code_point <= 0xdbff) {
+			long low;
+			if (size - i < 6 || str[i] != '\\' || str[i + 1] != 'u' ||
+					(low = read_hex4(str + i + 2)) < 0xdc00 ||
+					low > 0xdfff)
+				return JSON_UNESCAPE_ERROR;
+			i += 6;
+			code_point = 0x10000 +
+				((code_point - 0xd800) << 10) + (low - 0xdc00);
+		}
+
+		written += write_utf8(out + written, (unsigned long)code_point);
+	}
+}
@@ -0,0 +1,69 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_ESCAPE_H
+#define JONSON_ESCAPE_H
+
+#include <stddef.h>
+
+#include "strbuffer.h"
+
+/*
+ * Returns the offset of the first character in [str] that has to be
+ * escaped within a JSON string (quotation mark, reverse solidus or a
+ * control character), or [size] if there is none.
+ */
+size_t json_escape_scan(const char *str, size_t size);
+
+/*
+ * Upper bound of the number of characters json_escape_char() writes.
+ */
+#define JSON_ESCAPE_MAX_SIZE 6
+
+/*
+ * Writes the escape sequence of a character that has to be escaped,
+ * as found by json_escape_scan(), and returns its length.
+ */
+size_t json_escape_char(char *out, unsigned char c);
+
+/*
+ * Appends [str] to the buffer, escaping all characters that may not
+ * appear literally within a JSON string. Runs without any special
+ * characters are copied in bulk. The surrounding quotation marks are
+ * not written. Returns the number of bytes appended.
+ */
+size_t json_escape_n(struct strbuffer *sb, const char *str, size_t size);
+#define json_escape(sb, str) \
+	json_escape_n(sb, str, (str) ? strlen(str) : 0)
+
+/*
+ * Returns the value of a hexadecimal digit, or -1 if [c] is none.
+ */
+static inline int json_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Decodes the escape sequences of a string body, i.e. the characters
+ * between its quotation marks, into [out], which has to provide room
+ * for [size] bytes since a decoded string is never longer. Escaped code
+ * points are written as UTF-8. Returns the decoded size, or
+ * JSON_UNESCAPE_ERROR if an escape sequence is invalid, a surrogate
+ * is not part of a pair or it is \u0000, which strings cannot hold as
+ * they are NUL-terminated.
+ */
+#define JSON_UNESCAPE_ERROR ((size_t)-1)
+
+size_t json_unescape_n(char *out, const char *str, size_t size);
+
+#endif /* JONSON_ESCAPE_H */
@@ -0,0 +1,177 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "file.h"
+#include "parse.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define FILE_MMAP 1
+#else
+#define FILE_MMAP 0
+#endif
+
+#define READ_SIZE (64 * 1024)
+
+static int read_stream(struct json_file *file, FILE *stream)
+{
+	size_t capacity = 0;
+
+	file->data = NULL;
+	file->size = 0;
+	file->mapped = 0;
+
+	for (;;) {
+		if (capacity - file->size < READ_SIZE) {
+			capacity = capacity ? capacity << 1 : READ_SIZE;
+			char *data = realloc(file->data, capacity);
+			if (!data)
+				goto error;
+			file->data = data;
+		}
+		size_t read = fread(file->data + file->size, 1,
+				    capacity - file->size, stream);
+		file->size += read;
+		if (read == 0)
+			break;
+	}
+	if (ferror(stream))
+		goto error;
+	return 1;
+
+error:
+	free(file->data);
+	file->data = NULL;
+	return 0;
+}
+
+#if FILE_MMAP
+static int map_file(struct json_file *file, int fd, size_t size)
+{
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return 0;
+
+	/* Parsing reads the text from front to back. */
+#ifdef MADV_SEQUENTIAL
+	madvise(data, size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+	madvise(data, size, MADV_WILLNEED);
+#endif
+
+	file->data = data;
+	file->size = size;
+	file->mapped = size;
+	return 1;
+}
+
+int json_file_open(struct json_file *file, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		goto error;
+
+	/* Empty files cannot be mapped. */
+	if (S_ISREG(st.st_mode) && st.st_size > 0 &&
+			map_file(file, fd, (size_t)st.st_size)) {
+		close(fd);
+		return 1;
+	}
+
+	FILE *stream = fdopen(fd, "rb");
+	if (!stream)
+		goto error;
+	int success = read_stream(file, stream);
+	fclose(stream);
+	return success;
+
+error:
+	close(fd);
+	return 0;
+}
+#else
+int json_file_open(struct json_file *file, const char *path)
+{
+	FILE *stream = fopen(path, "rb");
+	if (!stream)
+		return 0;
+	int success = read_stream(file, stream);
+	fclose(stream);
+	return success;
+}
+#endif
+
+void json_file_close(struct json_file *file)
+{
+#if FILE_MMAP
+	if (file->mapped) {
+		munmap(file->data, file->mapped);
+		return;
+	}
+#endif
+	free(file->data);
+}
+
+struct json_document *json_parse_file(const char *path, unsigned int flags)
+{
+	struct json_file *file = malloc(sizeof(struct json_file));
+	if (!file)
+		goto error_file;
+	if (!json_file_open(file, path))
+		goto error_open;
+
+	struct json_document *document =
+		json_document_new(flags & ~(JSON_FILE_BORROW |
+					    JSON_FILE_VALIDATE_UTF8));
+	if (!document)
+		goto error_document;
+
+	struct json_parser *parser = json_parser_new_in(document);
+	if (flags & JSON_FILE_BORROW)
+		json_parser_borrow_strings(parser);
+	if (flags & JSON_FILE_VALIDATE_UTF8)
+		json_parser_validate_utf8(parser);
+	struct json root = json_parser_parse_n(parser, file->data, file->size);
+	json_parser_free(parser);
+	if (JSON_TYPEOF(root) == JSON_TYPE_NONE)
+		goto error_parse;
+
+	if (!(flags & JSON_FILE_BORROW)) {
+		json_file_close(file);
+		free(file);
+		return document;
+	}
+
+#if FILE_MMAP && defined(MADV_NORMAL)
+	/* Borrowed strings are read in any order from now on. */
+	if (file->mapped)
+		madvise(file->data, file->mapped, MADV_NORMAL);
+#endif
+	document->input = file;
+	return document;
+
+error_parse:
+	json_document_free(document);
+error_document:
+	json_file_close(file);
+error_open:
+	free(file);
+error_file:
+	return NULL;
+}
@@ -0,0 +1,57 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_FILE_H
+#define JONSON_FILE_H
+
+#include <stddef.h>
+
+#include "jonson.h"
+#include "document.h"
+
+/*
+ * The contents of a file. Regular files are mapped into memory where
+ * the system supports it, anything else such as pipes is read into a
+ * buffer on the heap. [mapped] is the size of the mapping, or 0.
+ */
+struct json_file {
+	char *data;
+	size_t size;
+	size_t mapped;
+};
+
+/*
+ * Maps or reads the file at [path] into [file]. Returns 0 on failure.
+ */
+int json_file_open(struct json_file *file, const char *path);
+void json_file_close(struct json_file *file);
+
+/*
+ * Borrow strings and keys without escape sequences from the file (see
+ * json_parser_borrow_strings()). The file then stays open until the
+ * document is freed or reset.
+ */
+#define JSON_FILE_BORROW 0x100
+
+/*
+ * Reject files that are not well-formed UTF-8 (see
+ * json_parser_validate_utf8()).
+ */
+#define JSON_FILE_VALIDATE_UTF8 0x200
+
+/*
+ * Parses the file at [path] straight from memory into a new document,
+ * without copying it first. [flags] are JSON_FILE_BORROW,
+ * JSON_FILE_VALIDATE_UTF8 and those of json_document_new(). Returns
+ * NULL if the file cannot be read, is not valid JSON or is 4 GiB or
+ * larger, which the parser cannot index (see struct json_parser).
+ * Larger newline-delimited files or top-level arrays can be parsed
+ * with json_parse_records_file() or json_parse_array_file(), which
+ * only limit each record or element to that size.
+ */
+struct json_document *json_parse_file(const char *path, unsigned int flags);
+
+#endif /* JONSON_FILE_H */
@@ -0,0 +1,108 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "jonson.h"
+#include "intern.h"
+
+#define INIT_SLOTS 64
+
+struct json_intern *json_intern_new(void)
+{
+	struct json_intern *keys = malloc(sizeof(struct json_intern));
+	if (!keys)
+		goto error_keys;
+
+	keys->slots = calloc(INIT_SLOTS, sizeof(struct json_intern_slot));
+	if (!keys->slots)
+		goto error_slots;
+
+	keys->arena = json_arena_new(0, 0);
+	if (!keys->arena)
+		goto error_arena;
+
+	keys->references = 1;
+	keys->size = 0;
+	keys->mask = INIT_SLOTS - 1;
+	return keys;
+
+error_arena:
+	free(keys->slots);
+error_slots:
+	free(keys);
+error_keys:
+	return NULL;
+}
+
+void json_intern_release(struct json_intern *keys)
+{
+	if (--keys->references)
+		return;
+
+	json_arena_free(keys->arena);
+	free(keys->slots);
+	free(keys);
+}
+
+static int grow(struct json_intern *keys)
+{
+	size_t count = (keys->mask + 1) << 1;
+	struct json_intern_slot *slots =
+		calloc(count, sizeof(struct json_intern_slot));
+	if (!slots)
+		return 0;
+
+	for (size_t i = 0; i <= keys->mask; ++i) {
+		struct json_intern_slot *slot = keys->slots + i;
+		if (!slot->key)
+			continue;
+		size_t j = slot->hash & (count - 1);
+		while (slots[j].key)
+			j = (j + 1) & (count - 1);
+		slots[j] = *slot;
+	}
+
+	free(keys->slots);
+	keys->slots = slots;
+	keys->mask = count - 1;
+	return 1;
+}
+
+const char *json_intern_n(struct json_intern *keys, const char *key,
+			  size_t size, uint32_t *out_hash)
+{
+	if (size >= UINT32_MAX)
+		return NULL;
+
+	uint32_t hash = json_hashn(key, size);
+	*out_hash = hash;
+
+	size_t i = hash & keys->mask;
+	for (; keys->slots[i].key; i = (i + 1) & keys->mask) {
+		struct json_intern_slot *slot = keys->slots + i;
+		if (slot->hash == hash && slot->size == size &&
+				memcmp(slot->key, key, size) == 0)
+			return slot->key;
+	}
+
+	/* Keep the table at most half full. */
+	if ((keys->size + 1) << 1 > keys->mask + 1) {
+		if (!grow(keys))
+			return NULL;
+		i = hash & keys->mask;
+		while (keys->slots[i].key)
+			i = (i + 1) & keys->mask;
+	}
+
+	char *copy = json_arena_strndup(keys->arena, key, size);
+	if (!copy)
+		return NULL;
+
+	keys->slots[i].key = copy;
+	keys->slots[i].size = (uint32_t)size;
+	keys->slots[i].hash = hash;
+	++keys->size;
+	return copy;
+}
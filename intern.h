@@ -0,0 +1,61 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_INTERN_H
+#define JONSON_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct json_arena;
+
+struct json_intern_slot {
+	const char *key;
+	uint32_t size;
+	uint32_t hash;
+};
+
+/*
+ * A pool of immutable, NUL-terminated object keys. Each distinct key is
+ * copied and hashed once, objects that intern their keys in the pool
+ * share these copies. Two keys of the same pool are equal if and only
+ * if their pointers are.
+ *
+ * The pool is reference counted: it starts out with one reference held
+ * by its creator, every heap object using it holds another one.
+ */
+struct json_intern {
+	size_t references;
+	size_t size;
+	size_t mask;
+	struct json_intern_slot *slots;
+	struct json_arena *arena;
+};
+
+/*
+ * Returns NULL on failure.
+ */
+struct json_intern *json_intern_new(void);
+
+static inline struct json_intern *json_intern_retain(struct json_intern *keys)
+{
+	++keys->references;
+	return keys;
+}
+
+/*
+ * Drops a reference, the pool is freed once the last one is gone.
+ */
+void json_intern_release(struct json_intern *keys);
+
+/*
+ * Returns the pooled copy of a key, adding it if necessary, and stores
+ * its hash in [out_hash]. Returns NULL on failure.
+ */
+const char *json_intern_n(struct json_intern *keys, const char *key,
+			  size_t size, uint32_t *out_hash);
+
+#endif /* JONSON_INTERN_H */
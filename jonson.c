@@ -5,7 +5,6 @@
  */
 
 #include <stdarg.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "jonson.h"
@@ -13,145 +12,445 @@
 #include "array.h"
 // #include "token.h"
 #include "strbuffer.h"
+#include "escape.h"
+#include "number.h"
+#include "pool.h"
 // #include "stack.h"
 
-struct json json_build(enum json_type type, ...)
+static struct json json_vbuild(struct json_arena *arena,
+			       enum json_type type, va_list args)
 {
-	struct json result;
-
-	va_list args;
-	va_start(args, type);
-
 	if (type == JSON_TYPE_OBJECT) {
-		struct json_object *object = json_object_new();
+		struct json_object *object = json_object_new_in(arena);
 		while (1) {
 			struct json_bucket bucket = va_arg(args, struct json_bucket);
-			if (bucket.value.type == JSON_TYPE_NONE)
+			if (JSON_TYPEOF(bucket.value) == JSON_TYPE_NONE)
 				break;
 			json_object_set(object, bucket.key, bucket.value);
 		}
-		result = JSON_OBJ(object);
+		return JSON_OBJ(object);
 	}
 	else {
-		struct json_array *array = json_array_new();
+		struct json_array *array = json_array_new_in(arena);
 		while (1) {
 			struct json value = va_arg(args, struct json);
-			if (value.type == JSON_TYPE_NONE)
+			if (JSON_TYPEOF(value) == JSON_TYPE_NONE)
 				break;
 			json_array_add(array, value);
 		}
-		result = JSON_ARR(array);
+		return JSON_ARR(array);
 	}
+}
 
+struct json json_build(enum json_type type, ...)
+{
+	va_list args;
+	va_start(args, type);
+	struct json result = json_vbuild(NULL, type, args);
 	va_end(args);
 	return result;
 }
 
+struct json json_build_in(struct json_arena *arena, enum json_type type, ...)
+{
+	va_list args;
+	va_start(args, type);
+	struct json result = json_vbuild(arena, type, args);
+	va_end(args);
+	return result;
+}
+
+struct json json_borrow_in(struct json_arena *arena,
+			   const char *data, size_t size)
+{
+	if (size >= JSON_BORROW_MAX)
+		return JSON_NONE;
+
+#ifdef JSON_NAN_BOXING
+	struct json_slice *slice = json_alloc(arena, sizeof(struct json_slice));
+	if (!slice)
+		return JSON_NONE;
+	slice->data = data;
+	slice->size = size;
+	return json_box(JSON_BOX_SLICE, slice);
+#else
+	struct json value = {
+		.type = JSON_TYPE_STRING,
+		.value.string = (char *)data,
+		.string_size = (unsigned int)size,
+		.borrowed = 1
+	};
+	return value;
+#endif
+}
+
 void json_free(struct json value)
 {
-	switch (value.type) {
-	case JSON_TYPE_STRING: free(JSON_STRVAL(value)); return;
+	switch (JSON_TYPEOF(value)) {
+	case JSON_TYPE_STRING:
+#ifdef JSON_NAN_BOXING
+		/* Only the slice of a borrowed string is owned. */
+		if (JSON_BORROWED(value))
+			free((void *)(uintptr_t)(value.bits & JSON_BOX_PAYLOAD));
+		else
+			free(JSON_STRVAL(value));
+#else
+		if (!value.borrowed)
+			free(JSON_STRVAL(value));
+#endif
+		return;
 	case JSON_TYPE_OBJECT: json_object_free(JSON_OBJVAL(value)); return;
 	case JSON_TYPE_ARRAY:  json_array_free(JSON_ARRVAL(value)); return;
 	default: return;
 	}
 }
 
-char *json_serialise(struct json value)
+/*
+ * Initial number of frames of the serialisation stack. Documents that are
+ * nested deeper than this move the stack to the heap.
+ */
+#define SERIALISE_STACK_SIZE 32
+
+/*
+ * Rough guesses of how many characters a nested value takes up,
+ * used to pre-size the output buffer before serialising.
+ */
+#define ESTIMATE_NUMBER_SIZE  24
+#define ESTIMATE_ELEMENT_SIZE 16
+#define ESTIMATE_MEMBER_SIZE  32
+
+struct serialise_frame {
+	struct json container;
+	size_t index;
+};
+
+/*
+ * Estimates the size of a serialised value by only looking at the value
+ * itself and its direct children. Nothing nested deeper is visited.
+ */
+static size_t serialise_estimate(struct json value)
 {
-	struct strbuffer *sb = strbuffer_new();
+	switch (JSON_TYPEOF(value)) {
+	case JSON_TYPE_STRING:
+		return JSON_STRLEN(value) + 2;
+	case JSON_TYPE_NUMBER:
+		return ESTIMATE_NUMBER_SIZE;
+	case JSON_TYPE_OBJECT:
+		return 2 + JSON_OBJVAL(value)->size * ESTIMATE_MEMBER_SIZE;
+	case JSON_TYPE_ARRAY:
+		return 2 + JSON_ARRVAL(value)->size * ESTIMATE_ELEMENT_SIZE;
+	default:
+		return 5;
+	}
+}
 
-	switch (value.type) {
+static void serialise_string(struct strbuffer *sb,
+			     const char *string, size_t size)
+{
+	strbuffer_ensure(sb, size + 2);
+	strbuffer_append_char(sb, '"');
+	json_escape_n(sb, string, size);
+	strbuffer_append_char(sb, '"');
+}
+
+/*
+ * Writes a scalar or the opening bracket of a container.
+ * Returns 1 if the value is a non-empty container whose children
+ * have to be serialised next.
+ */
+static int serialise_value(struct strbuffer *sb, struct json value)
+{
+	switch (JSON_TYPEOF(value)) {
 	case JSON_TYPE_NONE:
 	case JSON_TYPE_NULL:
-		strbuffer_append(sb, "null");
-		break;
-	case JSON_TYPE_STRING: {
-		const char *string = JSON_STRVAL(value);
-		size_t size = strlen(string);
-
-		strbuffer_reserve(sb, size + 2 + 1);
-		strbuffer_append_char(sb, '"');
-
-		size_t i;
-		for (i = 0; i < size; ++i) {
-			char unescaped = 0;
-			switch (string[i]) {
-			case '\\': unescaped = '\\';
-			case '"': unescaped = '"';
-			case '/': unescaped = '/';
-			case '\b': unescaped = 'b';
-			case '\f': unescaped = 'f';
-			case '\n': unescaped = 'n';
-			case '\r': unescaped = 'r';
-			case '\t': unescaped = 't';
-			default:
-				strbuffer_append_char(sb, string[i]);
-				continue;
+		strbuffer_appendn(sb, "null", 4);
+		return 0;
+	case JSON_TYPE_STRING:
+		serialise_string(sb, JSON_STRVAL(value), JSON_STRLEN(value));
+		return 0;
+	case JSON_TYPE_NUMBER:
+		strbuffer_ensure(sb, JSON_NUMBER_MAX_SIZE);
+		sb->size += json_number_format(JSON_NUMVAL(value),
+					       sb->buffer + sb->size);
+		return 0;
+	case JSON_TYPE_BOOLEAN:
+		if (JSON_BOOLVAL(value))
+			strbuffer_appendn(sb, "true", 4);
+		else
+			strbuffer_appendn(sb, "false", 5);
+		return 0;
+	case JSON_TYPE_OBJECT:
+		if (JSON_OBJVAL(value)->size == 0) {
+			strbuffer_appendn(sb, "{}", 2);
+			return 0;
+		}
+		strbuffer_append_char(sb, '{');
+		return 1;
+	case JSON_TYPE_ARRAY:
+		if (JSON_ARRVAL(value)->size == 0) {
+			strbuffer_appendn(sb, "[]", 2);
+			return 0;
+		}
+		strbuffer_append_char(sb, '[');
+		return 1;
+	}
+	return 0;
+}
+
+size_t json_serialise_into(struct strbuffer *sb, struct json value)
+{
+	struct serialise_frame initial_frames[SERIALISE_STACK_SIZE];
+	struct serialise_frame *frames = initial_frames;
+	size_t capacity = SERIALISE_STACK_SIZE;
+	size_t depth = 0;
+	size_t previous_size = sb->size;
+
+	strbuffer_reserve(sb, sb->size + serialise_estimate(value));
+
+	for (;;) {
+		if (serialise_value(sb, value)) {
+			if (depth == capacity) {
+				capacity <<= 1;
+				if (frames == initial_frames) {
+					frames = emalloc(capacity, sizeof(*frames));
+					memcpy(frames, initial_frames, sizeof(initial_frames));
+				}
+				else
+					frames = erealloc(frames, capacity, sizeof(*frames));
 			}
-			strbuffer_append_char(sb, '\\');
-			strbuffer_append_char(sb, unescaped);
+			frames[depth].container = value;
+			frames[depth].index = 0;
+			++depth;
 		}
 
-		strbuffer_append_char(sb, '"');
-		break;
-	}
-	case JSON_TYPE_NUMBER: {
-		strbuffer_reserve(sb, 21);
-		char buf[21];
-		snprintf(buf, 21, "%.16g", JSON_NUMVAL(value));
-		strbuffer_append(sb, buf);
-		break;
-	}
-	case JSON_TYPE_BOOLEAN: {
-		int boolean = JSON_BOOLVAL(value);
-		strbuffer_reserve(sb, 4 + !boolean + 1);
-		strbuffer_append(sb, boolean ? "true" : "false");
-		break;
+		/* Close finished containers until one has a child left. */
+		while (depth > 0) {
+			struct serialise_frame *frame = frames + depth - 1;
+
+			if (JSON_TYPEOF(frame->container) == JSON_TYPE_ARRAY) {
+				struct json_array *array = JSON_ARRVAL(frame->container);
+				if (frame->index < array->size) {
+					if (frame->index > 0)
+						strbuffer_append_char(sb, ',');
+					value = array->data[frame->index++];
+					break;
+				}
+				strbuffer_append_char(sb, ']');
+			}
+			else {
+				struct json_object *object = JSON_OBJVAL(frame->container);
+				struct json_entry *entry =
+					json_object_next(object, &frame->index);
+				if (entry) {
+					/* Removed entries may precede the first one,
+					 * so look at what was written last. */
+					if (sb->buffer[sb->size - 1] != '{')
+						strbuffer_append_char(sb, ',');
+					serialise_string(sb, entry->key, entry->key_size);
+					strbuffer_append_char(sb, ':');
+					value = entry->value;
+					break;
+				}
+				strbuffer_append_char(sb, '}');
+			}
+			--depth;
+		}
+
+		if (depth == 0)
+			break;
 	}
-	case JSON_TYPE_OBJECT: {
-		struct json_object *object = JSON_OBJVAL(value);
-		strbuffer_append_char(sb, '{');
 
-		for (size_t i = 0; i < object->size; ++i) {
-			struct json_bucket *bucket = object->buckets + object->order[i];
-			char *value = json_serialise(bucket->value);
-			char *key = bucket->key;
+	if (frames != initial_frames)
+		free(frames);
 
-			strbuffer_append_char(sb, '"');
-			strbuffer_append(sb, key);
-			strbuffer_append_char(sb, '"');
-			strbuffer_append_char(sb, ':');
-			strbuffer_append(sb, value);
-			if (i < object->size - 1)
-				strbuffer_append_char(sb, ',');
+	return sb->size - previous_size;
+}
 
-			free(value);
-		}
+char *json_serialise_n(struct json value, size_t *size)
+{
+	struct strbuffer sb = { 0 };
+
+	json_serialise_into(&sb, value);
+	if (size)
+		*size = sb.size;
 
-		strbuffer_append_char(sb, '}');
-		break;
+	/* The buffer is handed out as is, no copy is made. */
+	strbuffer_append_char(&sb, 0);
+	return sb.buffer;
+}
+
+char *json_serialise(struct json value)
+{
+	return json_serialise_n(value, NULL);
+}
+
+/*
+ * Children that are looked at to estimate the size of a container,
+ * and ranges of children that each thread gets on average.
+ */
+#define PARALLEL_SAMPLES          16
+#define PARALLEL_RANGES_PER_THREAD 16
+
+struct serialise_range {
+	struct strbuffer sb;
+	size_t offset;
+};
+
+struct serialise_job {
+	struct json container;
+	size_t count; /* Elements or entries, including removed ones */
+	size_t per_range;
+	struct serialise_range *ranges;
+	char *output;
+};
+
+static inline struct json_entry *range_entry(struct json container,
+					     size_t index)
+{
+	struct json_entry *entry = JSON_OBJVAL(container)->entries + index;
+	return entry->key ? entry : NULL;
+}
+
+/*
+ * Estimates the size of a container from a sample of its children,
+ * looking one level deeper than serialise_estimate().
+ */
+static size_t parallel_estimate(struct json container, size_t count)
+{
+	size_t step = count / PARALLEL_SAMPLES ? count / PARALLEL_SAMPLES : 1;
+	size_t sampled = 0;
+	size_t size = 0;
+
+	for (size_t i = 0; i < count; i += step) {
+		if (JSON_TYPEOF(container) == JSON_TYPE_ARRAY)
+			size += serialise_estimate(JSON_ARRVAL(container)->data[i]);
+		else {
+			struct json_entry *entry = range_entry(container, i);
+			if (!entry)
+				continue;
+			size += entry->key_size + 3 +
+				serialise_estimate(entry->value);
+		}
+		++sampled;
 	}
-	case JSON_TYPE_ARRAY: {
-		struct json_array *array = JSON_ARRVAL(value);
-		strbuffer_append_char(sb, '[');
+	return sampled ? size / sampled * count : 0;
+}
 
-		size_t i = 0;
-		while (i < array->size) {
-			char *val = json_serialise(json_array_get(array, i));
-			strbuffer_append(sb, val);
-			free(val);
+static void serialise_range(void *context, size_t index, unsigned int thread)
+{
+	struct serialise_job *job = context;
+	struct strbuffer *sb = &job->ranges[index].sb;
+	size_t first = index * job->per_range;
+	size_t last = first + job->per_range;
+	if (last > job->count)
+		last = job->count;
 
-			if (++i < array->size)
+	for (size_t i = first; i < last; ++i) {
+		struct json value;
+		if (JSON_TYPEOF(job->container) == JSON_TYPE_ARRAY) {
+			value = JSON_ARRVAL(job->container)->data[i];
+			if (sb->size)
 				strbuffer_append_char(sb, ',');
 		}
+		else {
+			struct json_entry *entry = range_entry(job->container, i);
+			if (!entry)
+				continue;
+			if (sb->size)
+				strbuffer_append_char(sb, ',');
+			serialise_string(sb, entry->key, entry->key_size);
+			strbuffer_append_char(sb, ':');
+			value = entry->value;
+		}
+		/* Grow geometrically, json_serialise_into() would not. */
+		strbuffer_ensure(sb, serialise_estimate(value));
+		json_serialise_into(sb, value);
+	}
+}
+
+static void copy_range(void *context, size_t index, unsigned int thread)
+{
+	struct serialise_job *job = context;
+	struct serialise_range *range = job->ranges + index;
+	if (range->sb.size)
+		memcpy(job->output + range->offset, range->sb.buffer,
+		       range->sb.size);
+}
+
+size_t json_serialise_parallel_into(struct strbuffer *sb, struct json value,
+				    unsigned int threads)
+{
+	threads = json_pool_threads(threads);
+
+	struct serialise_job job = { value, 0, 0, NULL, NULL };
+	if (JSON_TYPEOF(value) == JSON_TYPE_ARRAY)
+		job.count = JSON_ARRVAL(value)->size;
+	else if (JSON_TYPEOF(value) == JSON_TYPE_OBJECT)
+		job.count = JSON_OBJVAL(value)->count;
 
-		strbuffer_append_char(sb, ']');
-		break;
+	if (threads == 1 || job.count < 2 ||
+			parallel_estimate(value, job.count) <
+			JSON_SERIALISE_PARALLEL_MIN)
+		return json_serialise_into(sb, value);
+
+	size_t ranges = (size_t)threads * PARALLEL_RANGES_PER_THREAD;
+	if (ranges > job.count)
+		ranges = job.count;
+	job.per_range = (job.count + ranges - 1) / ranges;
+	ranges = (job.count + job.per_range - 1) / job.per_range;
+	job.ranges = ecalloc(ranges, sizeof(struct serialise_range));
+
+	json_pool_run(threads, ranges, serialise_range, &job);
+
+	/* Join the non-empty ranges; a range is empty only if every entry
+	   of an object in it was removed. */
+	size_t previous_size = sb->size;
+	size_t size = 2;
+	for (size_t i = 0; i < ranges; ++i) {
+		struct serialise_range *range = job.ranges + i;
+		if (!range->sb.size)
+			continue;
+		if (size > 2)
+			++size;
+		range->offset = previous_size + size - 1;
+		size += range->sb.size;
 	}
+
+	strbuffer_reserve(sb, previous_size + size);
+	job.output = sb->buffer;
+	for (size_t i = 0; i < ranges; ++i) {
+		struct serialise_range *range = job.ranges + i;
+		if (!range->sb.size)
+			continue;
+		if (range->offset > previous_size + 1)
+			job.output[range->offset - 1] = ',';
+	}
+	if (JSON_TYPEOF(value) == JSON_TYPE_ARRAY) {
+		job.output[previous_size] = '[';
+		job.output[previous_size + size - 1] = ']';
+	}
+	else {
+		job.output[previous_size] = '{';
+		job.output[previous_size + size - 1] = '}';
 	}
+	json_pool_run(threads, ranges, copy_range, &job);
+	sb->size = previous_size + size;
 
-	char *result = strbuffer_to_string(sb);
-	strbuffer_free(sb);
-	return result;
+	for (size_t i = 0; i < ranges; ++i)
+		free(job.ranges[i].sb.buffer);
+	free(job.ranges);
+	return size;
+}
+
+char *json_serialise_parallel_n(struct json value, size_t *size,
+				unsigned int threads)
+{
+	struct strbuffer sb = { 0 };
+
+	json_serialise_parallel_into(&sb, value, threads);
+	if (size)
+		*size = sb.size;
+
+	strbuffer_append_char(&sb, 0);
+	return sb.buffer;
 }
@@ -9,18 +9,13 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 struct json_object;
 struct json_array;
-
-union json_value {
-	char *string;
-	double number;
-	int boolean;
-	struct json_object *object;
-	struct json_array *array;
-};
+struct json_arena;
+struct strbuffer;
 
 enum json_type {
 	JSON_TYPE_NONE,
@@ -32,14 +27,138 @@ enum json_type {
 	JSON_TYPE_ARRAY
 };
 
+#ifdef JSON_NAN_BOXING
+
+/*
+ * A value boxed into 8 bytes. Numbers are stored as the bits of the
+ * double itself, with all NaNs folded into one canonical quiet NaN.
+ * Every other value is a negative quiet NaN: the upper 16 bits hold
+ * 0xFFF8 or'ed with a tag, the lower 48 bits a pointer or boolean.
+ * This requires pointers to fit into 48 bits, as they do in user space
+ * on x86-64 and AArch64.
+ *
+ * Never access the bits directly, use JSON_TYPEOF() and the accessor
+ * macros at the bottom of this header.
+ */
+struct json {
+	uint64_t bits;
+};
+
+#define JSON_BOX_SHIFT   48
+#define JSON_BOX_PAYLOAD (((uint64_t)1 << JSON_BOX_SHIFT) - 1)
+#define JSON_BOX_NAN     ((uint64_t)0x7FF8 << JSON_BOX_SHIFT)
+#define JSON_BOX_TAG(tag) ((uint64_t)(0xFFF8 | (tag)) << JSON_BOX_SHIFT)
+
+enum json_box_tag {
+	JSON_BOX_NONE = 1,
+	JSON_BOX_NULL,
+	JSON_BOX_BOOLEAN,
+	JSON_BOX_STRING,
+	JSON_BOX_OBJECT,
+	JSON_BOX_ARRAY,
+	JSON_BOX_SLICE
+};
+
+/*
+ * A borrowed string has no room for its size in 8 bytes, so it is
+ * boxed as a pointer to this.
+ */
+struct json_slice {
+	const char *data;
+	size_t size;
+};
+
+static inline enum json_type json_typeof(struct json value)
+{
+	static const unsigned char types[8] = {
+		JSON_TYPE_NUMBER, JSON_TYPE_NONE, JSON_TYPE_NULL,
+		JSON_TYPE_BOOLEAN, JSON_TYPE_STRING, JSON_TYPE_OBJECT,
+		JSON_TYPE_ARRAY, JSON_TYPE_STRING
+	};
+	if (value.bits < JSON_BOX_TAG(1))
+		return JSON_TYPE_NUMBER;
+	return (enum json_type)types[(value.bits >> JSON_BOX_SHIFT) & 7];
+}
+
+static inline struct json json_box(enum json_box_tag tag, const void *ptr)
+{
+	struct json value = { JSON_BOX_TAG(tag) | (uintptr_t)ptr };
+	return value;
+}
+
+static inline struct json json_box_number(double number)
+{
+	struct json value;
+	memcpy(&value.bits, &number, sizeof(number));
+	/* NaNs share their bits with boxed values, keep only one. */
+	if (number != number)
+		value.bits = JSON_BOX_NAN;
+	return value;
+}
+
+static inline double json_unbox_number(struct json value)
+{
+	double number;
+	memcpy(&number, &value.bits, sizeof(number));
+	return number;
+}
+
+static inline int json_is_borrowed(struct json value)
+{
+	return (value.bits >> JSON_BOX_SHIFT) == (0xFFF8 | JSON_BOX_SLICE);
+}
+
+static inline char *json_unbox_string(struct json value)
+{
+	void *ptr = (void *)(uintptr_t)(value.bits & JSON_BOX_PAYLOAD);
+	if (json_is_borrowed(value))
+		return (char *)((struct json_slice *)ptr)->data;
+	return ptr;
+}
+
+static inline size_t json_strlen(struct json value)
+{
+	void *ptr = (void *)(uintptr_t)(value.bits & JSON_BOX_PAYLOAD);
+	if (json_is_borrowed(value))
+		return ((struct json_slice *)ptr)->size;
+	return strlen(ptr);
+}
+
+#define JSON_TYPEOF(v) json_typeof(v)
+
+#else
+
+union json_value {
+	char *string;
+	double number;
+	int boolean;
+	struct json_object *object;
+	struct json_array *array;
+};
+
 /*
  * Use the type to interpret the value correctly.
+ * Compile the library (make NAN_BOXING=1) and everything including
+ * this header with JSON_NAN_BOXING defined to store values in 8 bytes.
+ * Strings are owned and NUL-terminated, unless they are [borrowed],
+ * which only refer to [string_size] characters owned by someone else.
  */
 struct json {
 	union json_value value;
 	enum json_type type;
+	unsigned int string_size : 31;
+	unsigned int borrowed : 1;
 };
 
+#define JSON_TYPEOF(v) ((v).type)
+
+static inline size_t json_strlen(struct json value)
+{
+	return value.borrowed ? value.string_size : strlen(value.value.string);
+}
+
+#endif /* JSON_NAN_BOXING */
+
 /*
  * Creates a [struct json], with its root element being of the specified type.
  * Only types JSON_TYPE_OBJECT and JSON_TYPE_ARRAY are returned because
@@ -48,6 +167,17 @@ struct json {
  */
 struct json json_build(enum json_type type, ...);
 
+/*
+ * Same as json_build(), but the containers are allocated within [arena].
+ * The values passed should belong to the same arena (see JSON_STRN_IN()),
+ * since they are released together with it.
+ */
+struct json json_build_in(struct json_arena *arena, enum json_type type, ...);
+
+/*
+ * Releases a value and everything it contains. Borrowed strings are
+ * left alone.
+ */
 void json_free(struct json value);
 
 /*
@@ -57,6 +187,41 @@ void json_free(struct json value);
 char *json_serialise(struct json value);
 #define json_serialize(value) json_serialise(value)
 
+/*
+ * Same as json_serialise(), but also stores the length of the resulting
+ * string in [size], unless it is NULL.
+ */
+char *json_serialise_n(struct json value, size_t *size);
+#define json_serialize_n(value, size) json_serialise_n(value, size)
+
+/*
+ * Appends the serialised value to the end of a [struct strbuffer].
+ * The whole tree is written in a single pass into that one buffer,
+ * without any intermediate strings. Returns the number of bytes appended.
+ */
+size_t json_serialise_into(struct strbuffer *sb, struct json value);
+#define json_serialize_into(sb, value) json_serialise_into(sb, value)
+
+/*
+ * Same as json_serialise_into(), but the children of a large array or
+ * object are split into ranges that are serialised on [threads]
+ * threads, 0 for one per processor (see json_pool_run()), and joined
+ * afterwards. The output is identical. Values whose size is estimated
+ * to be below JSON_SERIALISE_PARALLEL_MIN from a sample of their
+ * children are serialised on the calling thread alone.
+ */
+#define JSON_SERIALISE_PARALLEL_MIN (1024 * 1024)
+
+size_t json_serialise_parallel_into(struct strbuffer *sb, struct json value,
+				    unsigned int threads);
+#define json_serialize_parallel_into(sb, value, threads) \
+	json_serialise_parallel_into(sb, value, threads)
+
+char *json_serialise_parallel_n(struct json value, size_t *size,
+				unsigned int threads);
+#define json_serialize_parallel_n(value, size, threads) \
+	json_serialise_parallel_n(value, size, threads)
+
 static inline char *json_strndup(const char *str, size_t size)
 {
 	char *copy = malloc((size + 1) * sizeof(char));
@@ -66,17 +231,45 @@ static inline char *json_strndup(const char *str, size_t size)
 
 /*
  * Encapsulates a value in a [struct json].
+ * JSON_STRP() takes over an allocated string without copying it.
  */
-#define JSON_STRN(data, size) \
-	((struct json){ .type = JSON_TYPE_STRING, \
-			.value.string = json_strndup(data, size) })
-#define JSON_STR(data) JSON_STRN(data, (data) ? strlen(data) : 0)
+#ifdef JSON_NAN_BOXING
+#define JSON_STRP(data) json_box(JSON_BOX_STRING, data)
+#define JSON_NUM(data) json_box_number(data)
+#define JSON_BOOL(data) ((struct json){ JSON_BOX_TAG(JSON_BOX_BOOLEAN) | !!(data) })
+#define JSON_OBJ(data) json_box(JSON_BOX_OBJECT, data)
+#define JSON_ARR(data) json_box(JSON_BOX_ARRAY, data)
+#define JSON_NULL ((struct json){ JSON_BOX_TAG(JSON_BOX_NULL) })
+#define JSON_NONE ((struct json){ JSON_BOX_TAG(JSON_BOX_NONE) })
+#else
+#define JSON_STRP(data) ((struct json){ .type = JSON_TYPE_STRING, .value.string = data })
 #define JSON_NUM(data) ((struct json){ .type = JSON_TYPE_NUMBER, .value.number = data })
 #define JSON_BOOL(data) ((struct json){ .type = JSON_TYPE_BOOLEAN, .value.boolean = data })
 #define JSON_OBJ(data) ((struct json){ .type = JSON_TYPE_OBJECT, .value.object = data })
 #define JSON_ARR(data) ((struct json){ .type = JSON_TYPE_ARRAY, .value.array = data })
 #define JSON_NULL ((struct json){ .type = JSON_TYPE_NULL, .value = { 0 } })
 #define JSON_NONE ((struct json){ .type = JSON_TYPE_NONE, .value = { 0 } })
+#endif
+#define JSON_STRN(data, size) JSON_STRP(json_strndup(data, size))
+#define JSON_STR(data) JSON_STRN(data, (data) ? strlen(data) : 0)
+#define JSON_STRN_IN(arena, data, size) \
+	JSON_STRP(json_arena_strndup(arena, data, size))
+#define JSON_STR_IN(arena, data) \
+	JSON_STRN_IN(arena, data, (data) ? strlen(data) : 0)
+
+/*
+ * Refers to [size] characters at [data] without copying them, which
+ * need not be NUL-terminated and have to outlive the value. Only
+ * strings shorter than JSON_BORROW_MAX can be borrowed. With
+ * JSON_NAN_BOXING a small [struct json_slice] is allocated within
+ * [arena] or on the heap, so JSON_NONE is returned on failure.
+ */
+#define JSON_BORROW_MAX ((size_t)1 << 31)
+
+struct json json_borrow_in(struct json_arena *arena,
+			   const char *data, size_t size);
+#define JSON_STRREF_IN(arena, data, size) json_borrow_in(arena, data, size)
+#define JSON_STRREF(data, size) json_borrow_in(NULL, data, size)
 
 /*
  * Macros for use with the function json_build().
@@ -87,13 +280,33 @@ static inline char *json_strndup(const char *str, size_t size)
 #define JSON_KVP(k, v) ((struct json_bucket){ .key = k, .value = v })
 #define JSON_KVP_END JSON_KVP(NULL, JSON_END)
 
+#ifdef JSON_NAN_BOXING
+#define JSON_UNBOX(v, type) ((type)(uintptr_t)((v).bits & JSON_BOX_PAYLOAD))
+#define JSON_STRVAL(v) json_unbox_string(v)
+#define JSON_BORROWED(v) json_is_borrowed(v)
+#define JSON_NUMVAL(v) json_unbox_number(v)
+#define JSON_BOOLVAL(v) ((int)((v).bits & 1))
+#define JSON_OBJVAL(v) JSON_UNBOX(v, struct json_object *)
+#define JSON_ARRVAL(v) JSON_UNBOX(v, struct json_array *)
+#else
 #define JSON_STRVAL(v) (v).value.string
+#define JSON_BORROWED(v) ((v).type == JSON_TYPE_STRING && (v).borrowed)
 #define JSON_NUMVAL(v) (v).value.number
 #define JSON_BOOLVAL(v) (v).value.boolean
 #define JSON_OBJVAL(v) (v).value.object
 #define JSON_ARRVAL(v) (v).value.array
+#endif
+
+/*
+ * Length of a string value, which is the only way to tell the end of a
+ * borrowed one.
+ */
+#define JSON_STRLEN(v) json_strlen(v)
 
+#include "arena.h"
+#include "intern.h"
 #include "object.h"
 #include "array.h"
+#include "document.h"
 
 #endif /* JONSON_H */
@@ -0,0 +1,863 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "number.h"
+#include "number_table.h"
+#include "simd.h"
+#include "token.h"
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BITS 11
+#define DOUBLE_BIAS          1023
+
+static const char digit_pairs[200] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
+
+/*
+ * Shortest round-trip formatting, following Ulf Adams' Ryu
+ * (https://doi.org/10.1145/3192366.3192369).
+ */
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 uint128;
+
+static inline uint64_t umul128(uint64_t a, uint64_t b, uint64_t *high)
+{
+	uint128 product = (uint128)a * b;
+	*high = (uint64_t)(product >> 64);
+	return (uint64_t)product;
+}
+#else
+static inline uint64_t umul128(uint64_t a, uint64_t b, uint64_t *high)
+{
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+	uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+	uint64_t b00 = a_lo * b_lo;
+	uint64_t b01 = a_lo * b_hi;
+	uint64_t b10 = a_hi * b_lo;
+	uint64_t b11 = a_hi * b_hi;
+
+	uint64_t mid1 = b10 + (b00 >> 32);
+	uint64_t mid2 = b01 + (uint32_t)mid1;
+
+	*high = b11 + (mid1 >> 32) + (mid2 >> 32);
+	return (mid2 << 32) | (uint32_t)b00;
+}
+#endif
+
+/*
+ * Multiplies [m] with the 128-bit [mul] and shifts the 192-bit
+ * product right by [shift], which must lie within [64, 128).
+ */
+static inline uint64_t mul_shift(uint64_t m, const uint64_t *mul, int shift)
+{
+	uint64_t high0, high1;
+	umul128(m, mul[0], &high0);
+	uint64_t low1 = umul128(m, mul[1], &high1);
+	uint64_t sum = high0 + low1;
+	if (sum < high0)
+		++high1;
+	shift -= 64;
+	if (shift == 0)
+		return sum;
+	return (high1 << (64 - shift)) | (sum >> shift);
+}
+
+static inline int pow5_bits(int e)
+{
+	return (int)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+static inline uint32_t log10_pow2(int e)
+{
+	return ((uint32_t)e * 78913) >> 18;
+}
+
+static inline uint32_t log10_pow5(int e)
+{
+	return ((uint32_t)e * 732923) >> 20;
+}
+
+static inline int multiple_of_pow5(uint64_t value, uint32_t p)
+{
+	uint32_t count = 0;
+	while (value % 5 == 0) {
+		value /= 5;
+		++count;
+	}
+	return count >= p;
+}
+
+static inline int multiple_of_pow2(uint64_t value, uint32_t p)
+{
+	return (value & ((1ull << p) - 1)) == 0;
+}
+
+/*
+ * Converts a finite, non-zero double given by its raw mantissa and
+ * exponent bits into the shortest [digits] * 10^[exponent] that lies
+ * within the rounding interval of the double.
+ */
+static void shortest(uint64_t ieee_mantissa, uint32_t ieee_exponent,
+		     uint64_t *digits, int *exponent)
+{
+	int e2;
+	uint64_t m2;
+	if (ieee_exponent == 0) {
+		e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = ieee_mantissa;
+	}
+	else {
+		e2 = (int)ieee_exponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = (1ull << DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+	}
+	int accept_bounds = (m2 & 1) == 0;
+
+	/* The interval of valid representations is [mm, mp] around mv,
+	   it is asymmetric at the lower boundary of an exponent. */
+	uint64_t mv = 4 * m2;
+	uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+	uint64_t vr, vp, vm;
+	int e10;
+	int vm_trailing_zeros = 0;
+	int vr_trailing_zeros = 0;
+
+	if (e2 >= 0) {
+		uint32_t q = log10_pow2(e2) - (e2 > 3);
+		int k = POW5_INV_BITCOUNT + pow5_bits(q) - 1;
+		int i = -e2 + (int)q + k;
+		e10 = (int)q;
+		vr = mul_shift(4 * m2, pow5_inv_split[q], i);
+		vp = mul_shift(4 * m2 + 2, pow5_inv_split[q], i);
+		vm = mul_shift(4 * m2 - 1 - mm_shift, pow5_inv_split[q], i);
+		if (q <= 21) {
+			/* Only one of mp, mv and mm can be a multiple of 5. */
+			if (mv % 5 == 0)
+				vr_trailing_zeros = multiple_of_pow5(mv, q);
+			else if (accept_bounds)
+				vm_trailing_zeros =
+					multiple_of_pow5(mv - 1 - mm_shift, q);
+			else
+				vp -= multiple_of_pow5(mv + 2, q);
+		}
+	}
+	else {
+		uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+		int i = -e2 - (int)q;
+		int k = pow5_bits(i) - POW5_BITCOUNT;
+		int j = (int)q - k;
+		e10 = (int)q + e2;
+		vr = mul_shift(4 * m2, pow5_split[i], j);
+		vp = mul_shift(4 * m2 + 2, pow5_split[i], j);
+		vm = mul_shift(4 * m2 - 1 - mm_shift, pow5_split[i], j);
+		if (q <= 1) {
+			/* mv = 4 * m2 always has at least two trailing zero bits. */
+			vr_trailing_zeros = 1;
+			if (accept_bounds)
+				vm_trailing_zeros = mm_shift == 1;
+			else
+				--vp;
+		}
+		else if (q < 63) {
+			vr_trailing_zeros = multiple_of_pow2(mv, q);
+		}
+	}
+
+	/* Remove digits as long as the interval still contains a number. */
+	int removed = 0;
+	uint64_t output;
+
+	if (vm_trailing_zeros || vr_trailing_zeros) {
+		/* Rare case, the exact value matters for rounding. */
+		int last_removed = 0;
+		while (vp / 10 > vm / 10) {
+			vm_trailing_zeros &= vm % 10 == 0;
+			vr_trailing_zeros &= last_removed == 0;
+			last_removed = vr % 10;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			++removed;
+		}
+		if (vm_trailing_zeros) {
+			while (vm % 10 == 0) {
+				vr_trailing_zeros &= last_removed == 0;
+				last_removed = vr % 10;
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				++removed;
+			}
+		}
+		if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+			last_removed = 4; /* Round half to even. */
+		output = vr + ((vr == vm && (!accept_bounds ||
+				!vm_trailing_zeros)) || last_removed >= 5);
+	}
+	else {
+		int round_up = 0;
+		if (vp / 100 > vm / 100) {
+			round_up = vr % 100 >= 50;
+			vr /= 100;
+			vp /= 100;
+			vm /= 100;
+			removed += 2;
+		}
+		while (vp / 10 > vm / 10) {
+			round_up = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			++removed;
+		}
+		output = vr + (vr == vm || round_up);
+	}
+
+	*digits = output;
+	*exponent = e10 + removed;
+}
+
+static inline int decimal_length(uint64_t v)
+{
+	int length = 1;
+	while (v >= 10) {
+		v /= 10;
+		++length;
+	}
+	return length;
+}
+
+/*
+ * Writes the [length] decimal digits of [v], right to left.
+ */
+static inline void write_digits(char *buf, uint64_t v, int length)
+{
+	char *p = buf + length;
+	while (v >= 100) {
+		unsigned int pair = (unsigned int)(v % 100) << 1;
+		v /= 100;
+		*--p = digit_pairs[pair + 1];
+		*--p = digit_pairs[pair];
+	}
+	if (v >= 10) {
+		unsigned int pair = (unsigned int)v << 1;
+		*--p = digit_pairs[pair + 1];
+		*--p = digit_pairs[pair];
+	}
+	else
+		*--p = '0' + (char)v;
+}
+
+size_t json_number_format(double value, char *buf)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	int sign = bits >> 63;
+	uint64_t ieee_mantissa = bits & ((1ull << DOUBLE_MANTISSA_BITS) - 1);
+	uint32_t ieee_exponent = (uint32_t)(bits >> DOUBLE_MANTISSA_BITS) &
+		((1u << DOUBLE_EXPONENT_BITS) - 1);
+
+	if (ieee_exponent == (1u << DOUBLE_EXPONENT_BITS) - 1) {
+		memcpy(buf, "null", 4);
+		return 4;
+	}
+
+	char *p = buf;
+	if (sign)
+		*p++ = '-';
+
+	if (ieee_exponent == 0 && ieee_mantissa == 0) {
+		*p++ = '0';
+		return p - buf;
+	}
+
+	/* Fast path for integers that are exactly representable. */
+	int e2 = (int)ieee_exponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS;
+	if (ieee_exponent != 0 && e2 <= 0 && e2 >= -DOUBLE_MANTISSA_BITS) {
+		uint64_t m2 = (1ull << DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+		if ((m2 & ((1ull << -e2) - 1)) == 0) {
+			uint64_t integer = m2 >> -e2;
+			int length = decimal_length(integer);
+			write_digits(p, integer, length);
+			return p + length - buf;
+		}
+	}
+
+	uint64_t digits;
+	int exponent;
+	shortest(ieee_mantissa, ieee_exponent, &digits, &exponent);
+
+	int length = decimal_length(digits);
+	/* Position of the decimal point relative to the first digit. */
+	int point = length + exponent;
+
+	if (length <= point && point <= 21) {
+		write_digits(p, digits, length);
+		p += length;
+		memset(p, '0', point - length);
+		p += point - length;
+	}
+	else if (0 < point && point <= 21) {
+		write_digits(p, digits, length);
+		memmove(p + point + 1, p + point, length - point);
+		p[point] = '.';
+		p += length + 1;
+	}
+	else if (-6 < point && point <= 0) {
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', -point);
+		p += -point;
+		write_digits(p, digits, length);
+		p += length;
+	}
+	else {
+		write_digits(p + 1, digits, length);
+		p[0] = p[1];
+		if (length > 1) {
+			p[1] = '.';
+			p += length + 1;
+		}
+		else
+			p += 1;
+
+		int e10 = point - 1;
+		*p++ = 'e';
+		*p++ = e10 < 0 ? '-' : '+';
+		if (e10 < 0)
+			e10 = -e10;
+		int e_length = decimal_length(e10);
+		write_digits(p, e10, e_length);
+		p += e_length;
+	}
+
+	return p - buf;
+}
+
+/*
+ * Parsing.
+ */
+
+enum number_state {
+	NUMBER_BEGIN,     /* Nothing read yet */
+	NUMBER_SIGN,      /* Minus sign */
+	NUMBER_ZERO,      /* Integer part consisting of a single zero */
+	NUMBER_INTEGER,   /* Integer part */
+	NUMBER_POINT,     /* Decimal point */
+	NUMBER_FRACTION,  /* Fractional part */
+	NUMBER_E,         /* Exponent marker */
+	NUMBER_EXP_SIGN,  /* Sign of the exponent */
+	NUMBER_EXPONENT   /* Exponent digits */
+};
+
+/* Digits that fit into the 64-bit mantissa without overflowing it. */
+#define MANTISSA_DIGITS 19
+
+/* Exponents are clamped here, far beyond the range of a double. */
+#define EXPONENT_LIMIT 100000000000000ll
+
+#define DOUBLE_INFINITY_BITS 0x7ff0000000000000ull
+
+void json_number_init(struct json_number *number)
+{
+	number->state = NUMBER_BEGIN;
+	number->negative = 0;
+	number->exponent_negative = 0;
+	number->sticky = 0;
+	number->mantissa = 0;
+	number->count = 0;
+	number->scale = 0;
+	number->exponent = 0;
+	number->stored = 0;
+}
+
+static inline void push_digit(struct json_number *number, int digit)
+{
+	if (number->count == 0 && digit == 0)
+		return;
+	if (number->count < MANTISSA_DIGITS)
+		number->mantissa = number->mantissa * 10 + digit;
+	if (number->stored < JSON_NUMBER_MAX_DIGITS)
+		number->digits[number->stored++] = (unsigned char)digit;
+	else if (digit)
+		number->sticky = 1;
+	++number->count;
+}
+
+int json_number_push(struct json_number *number, char c)
+{
+	int digit = c >= '0' && c <= '9';
+
+	switch (number->state) {
+	case NUMBER_BEGIN:
+		if (c == '-') {
+			number->negative = 1;
+			number->state = NUMBER_SIGN;
+			return 1;
+		}
+		/* fall through */
+	case NUMBER_SIGN:
+		if (!digit)
+			return 0;
+		push_digit(number, c - '0');
+		number->state = c == '0' ? NUMBER_ZERO : NUMBER_INTEGER;
+		return 1;
+	case NUMBER_INTEGER:
+		if (digit) {
+			push_digit(number, c - '0');
+			return 1;
+		}
+		/* fall through */
+	case NUMBER_ZERO:
+		if (c == '.') {
+			number->state = NUMBER_POINT;
+			return 1;
+		}
+		if (c == 'e' || c == 'E') {
+			number->state = NUMBER_E;
+			return 1;
+		}
+		return 0;
+	case NUMBER_POINT:
+	case NUMBER_FRACTION:
+		if (digit) {
+			push_digit(number, c - '0');
+			--number->scale;
+			number->state = NUMBER_FRACTION;
+			return 1;
+		}
+		if (number->state == NUMBER_FRACTION && (c == 'e' || c == 'E')) {
+			number->state = NUMBER_E;
+			return 1;
+		}
+		return 0;
+	case NUMBER_E:
+		if (c == '-' || c == '+') {
+			number->exponent_negative = c == '-';
+			number->state = NUMBER_EXP_SIGN;
+			return 1;
+		}
+		/* fall through */
+	case NUMBER_EXP_SIGN:
+	case NUMBER_EXPONENT:
+		if (!digit)
+			return 0;
+		if (number->exponent < EXPONENT_LIMIT)
+			number->exponent = number->exponent * 10 + (c - '0');
+		number->state = NUMBER_EXPONENT;
+		return 1;
+	}
+	return 0;
+}
+
+static inline void push_digits(struct json_number *number,
+			       const char *str, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		push_digit(number, str[i] - '0');
+}
+
+size_t json_number_push_n(struct json_number *number,
+			  const char *str, size_t size)
+{
+	size_t i = 0;
+	while (i < size) {
+		size_t run;
+
+		/* Runs of digits are measured and taken at once. */
+		switch (number->state) {
+		case NUMBER_INTEGER:
+			run = json_token_digits(str + i, size - i);
+			push_digits(number, str + i, run);
+			i += run;
+			break;
+		case NUMBER_POINT:
+		case NUMBER_FRACTION:
+			run = json_token_digits(str + i, size - i);
+			push_digits(number, str + i, run);
+			number->scale -= (int64_t)run;
+			if (run)
+				number->state = NUMBER_FRACTION;
+			i += run;
+			break;
+		}
+
+		if (i == size || !json_number_push(number, str[i]))
+			break;
+		++i;
+	}
+	return i;
+}
+
+int json_number_complete(const struct json_number *number)
+{
+	switch (number->state) {
+	case NUMBER_ZERO:
+	case NUMBER_INTEGER:
+	case NUMBER_FRACTION:
+	case NUMBER_EXPONENT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static const double exact_powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Eisel-Lemire: computes the double nearest to w * 10^q from a 128-bit
+ * approximation of 5^q (https://arxiv.org/abs/2101.11408). [exact] is
+ * cleared in the rare case the approximation cannot decide the result,
+ * which is then at most one unit in the last place off.
+ */
+static uint64_t eisel_lemire(uint64_t w, int64_t q, int *exact)
+{
+	*exact = 1;
+	if (q < POW5_128_MIN_EXPONENT)
+		return 0;
+	if (q > POW5_128_MAX_EXPONENT)
+		return DOUBLE_INFINITY_BITS;
+
+	int lz = json_clz64(w);
+	w <<= lz;
+
+	const uint64_t *pow5 = pow5_128[q - POW5_128_MIN_EXPONENT];
+	uint64_t high;
+	uint64_t low = umul128(w, pow5[1], &high);
+	if ((high & 0x1ff) == 0x1ff) {
+		uint64_t second_high;
+		umul128(w, pow5[0], &second_high);
+		low += second_high;
+		if (second_high > low)
+			++high;
+		if (low == UINT64_MAX && (q < -27 || q > 55))
+			*exact = 0;
+	}
+
+	int upper_bit = (int)(high >> 63);
+	int shift = upper_bit + 64 - DOUBLE_MANTISSA_BITS - 3;
+	uint64_t mantissa = high >> shift;
+	int power2 = (int)(((217706 * q) >> 16) + 63) + upper_bit - lz +
+		DOUBLE_BIAS;
+
+	if (power2 <= 0) {
+		/* Subnormal, or it rounds up to the smallest normal. */
+		if (-power2 + 1 >= 64)
+			return 0;
+		mantissa >>= -power2 + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		power2 = mantissa < (1ull << DOUBLE_MANTISSA_BITS) ? 0 : 1;
+		return ((uint64_t)power2 << DOUBLE_MANTISSA_BITS) |
+			(mantissa & ((1ull << DOUBLE_MANTISSA_BITS) - 1));
+	}
+
+	/* Exactly halfway, round down to even instead of up. */
+	if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+			(mantissa << shift) == high)
+		mantissa &= ~1ull;
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >= (2ull << DOUBLE_MANTISSA_BITS)) {
+		mantissa = 1ull << DOUBLE_MANTISSA_BITS;
+		++power2;
+	}
+	mantissa &= ~(1ull << DOUBLE_MANTISSA_BITS);
+
+	if (power2 >= (1 << DOUBLE_EXPONENT_BITS) - 1)
+		return DOUBLE_INFINITY_BITS;
+	return ((uint64_t)power2 << DOUBLE_MANTISSA_BITS) | mantissa;
+}
+
+/*
+ * Big integers, only used for the exact comparisons of the slow path.
+ * 5000 bits hold any decimal number that can still round to a finite,
+ * non-zero double, scaled to an integer.
+ */
+#define BIGINT_LIMBS 160
+
+struct bigint {
+	size_t size;
+	uint32_t limbs[BIGINT_LIMBS];
+};
+
+static void bigint_mul_add(struct bigint *b, uint32_t factor, uint32_t addend)
+{
+	uint64_t carry = addend;
+	for (size_t i = 0; i < b->size; ++i) {
+		uint64_t product = (uint64_t)b->limbs[i] * factor + carry;
+		b->limbs[i] = (uint32_t)product;
+		carry = product >> 32;
+	}
+	if (carry && b->size < BIGINT_LIMBS)
+		b->limbs[b->size++] = (uint32_t)carry;
+}
+
+static void bigint_mul_pow5(struct bigint *b, uint64_t exponent)
+{
+	static const uint32_t pow5[14] = {
+		1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125,
+		9765625, 48828125, 244140625, 1220703125
+	};
+	for (; exponent >= 13; exponent -= 13)
+		bigint_mul_add(b, pow5[13], 0);
+	if (exponent)
+		bigint_mul_add(b, pow5[exponent], 0);
+}
+
+static void bigint_shift_left(struct bigint *b, uint64_t shift)
+{
+	size_t words = shift / 32;
+	unsigned int bits = shift % 32;
+
+	if (b->size == 0)
+		return;
+	if (b->size + words + 1 > BIGINT_LIMBS)
+		words = BIGINT_LIMBS - b->size - 1;
+
+	b->limbs[b->size] = 0;
+	for (size_t i = b->size + 1; i-- > 0;) {
+		uint32_t limb = b->limbs[i] << bits;
+		if (bits && i > 0)
+			limb |= b->limbs[i - 1] >> (32 - bits);
+		b->limbs[i + words] = limb;
+	}
+	memset(b->limbs, 0, words * sizeof(uint32_t));
+	b->size += words + 1;
+	while (b->size && !b->limbs[b->size - 1])
+		--b->size;
+}
+
+static int bigint_compare(const struct bigint *a, const struct bigint *b)
+{
+	if (a->size != b->size)
+		return a->size < b->size ? -1 : 1;
+	for (size_t i = a->size; i-- > 0;)
+		if (a->limbs[i] != b->limbs[i])
+			return a->limbs[i] < b->limbs[i] ? -1 : 1;
+	return 0;
+}
+
+static void bigint_set(struct bigint *b, uint64_t value)
+{
+	b->size = 0;
+	while (value) {
+		b->limbs[b->size++] = (uint32_t)value;
+		value >>= 32;
+	}
+}
+
+/*
+ * Compares the decimal number given by the stored digits and [e10] with
+ * the point halfway between the double [bits] and its successor.
+ */
+static int compare_halfway(const struct json_number *number,
+			   int64_t e10, uint64_t bits)
+{
+	uint64_t m2 = bits & ((1ull << DOUBLE_MANTISSA_BITS) - 1);
+	int exponent = (int)(bits >> DOUBLE_MANTISSA_BITS);
+	int64_t e2;
+	if (exponent == 0)
+		e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS;
+	else {
+		m2 |= 1ull << DOUBLE_MANTISSA_BITS;
+		e2 = exponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS;
+	}
+
+	struct bigint decimal, halfway;
+	bigint_set(&decimal, 0);
+	uint32_t chunk = 0, factor = 1;
+	for (size_t i = 0; i < number->stored; ++i) {
+		chunk = chunk * 10 + number->digits[i];
+		factor *= 10;
+		if (factor == 1000000000) {
+			bigint_mul_add(&decimal, factor, chunk);
+			chunk = 0;
+			factor = 1;
+		}
+	}
+	if (number->sticky) {
+		/* Sticky digit for everything that was not stored. */
+		chunk = chunk * 10 + 1;
+		factor *= 10;
+	}
+	if (factor > 1)
+		bigint_mul_add(&decimal, factor, chunk);
+
+	bigint_set(&halfway, 2 * m2 + 1);
+	int64_t decimal_power2 = 0;
+	int64_t halfway_power2 = e2 - 1;
+	if (e10 >= 0) {
+		bigint_mul_pow5(&decimal, e10);
+		decimal_power2 += e10;
+	}
+	else {
+		bigint_mul_pow5(&halfway, -e10);
+		halfway_power2 -= e10;
+	}
+
+	if (decimal_power2 > halfway_power2)
+		bigint_shift_left(&decimal, decimal_power2 - halfway_power2);
+	else
+		bigint_shift_left(&halfway, halfway_power2 - decimal_power2);
+
+	return bigint_compare(&decimal, &halfway);
+}
+
+/*
+ * Moves the approximation [bits] to the correctly rounded result, one
+ * unit in the last place at a time.
+ */
+static uint64_t number_slow(const struct json_number *number, uint64_t bits)
+{
+	int64_t e10 = number->scale +
+		(number->exponent_negative ? -number->exponent : number->exponent) +
+		(int64_t)(number->count - number->stored) - number->sticky;
+
+	for (;;) {
+		if (bits == DOUBLE_INFINITY_BITS) {
+			if (compare_halfway(number, e10, bits - 1) >= 0)
+				return bits;
+			--bits;
+			continue;
+		}
+		int above = compare_halfway(number, e10, bits);
+		if (above > 0) {
+			++bits;
+			continue;
+		}
+		if (above == 0) {
+			/* Ties go to the even neighbour. */
+			return bits + (bits & 1);
+		}
+		if (bits == 0)
+			return bits;
+		int below = compare_halfway(number, e10, bits - 1);
+		if (below < 0) {
+			--bits;
+			continue;
+		}
+		if (below == 0)
+			return bits - (bits & 1);
+		return bits;
+	}
+}
+
+/*
+ * Returns 1 if any digit was dropped from the 64-bit mantissa that is
+ * not a zero.
+ */
+static int mantissa_truncated(const struct json_number *number)
+{
+	if (number->count <= MANTISSA_DIGITS)
+		return 0;
+	for (size_t i = MANTISSA_DIGITS; i < number->stored; ++i)
+		if (number->digits[i])
+			return 1;
+	return number->sticky;
+}
+
+static double number_convert(const struct json_number *number)
+{
+	uint64_t w = number->mantissa;
+	int64_t digits = number->count < MANTISSA_DIGITS ?
+		(int64_t)number->count : MANTISSA_DIGITS;
+	int64_t q = number->scale +
+		(number->exponent_negative ? -number->exponent : number->exponent) +
+		(int64_t)number->count - digits;
+	int truncated = mantissa_truncated(number);
+	uint64_t bits;
+	double value;
+
+	/* w * 10^q < 10^(digits + q) */
+	if (digits + q <= -324)
+		return 0.0;
+	if (digits - 1 + q >= 309) {
+		bits = DOUBLE_INFINITY_BITS;
+		goto done;
+	}
+
+	if (!truncated && w <= (1ull << 53) && q >= -22 && q <= 22) {
+		/* Both operands are exact, so is the rounded result. */
+		value = (double)w;
+		return q < 0 ? value / exact_powers[-q] : value * exact_powers[q];
+	}
+
+	int exact;
+	bits = eisel_lemire(w, q, &exact);
+	if (truncated && exact) {
+		/* The exact value lies within [w, w + 1) * 10^q. */
+		uint64_t upper = eisel_lemire(w + 1, q, &exact);
+		exact = exact && upper == bits;
+	}
+	if (!exact)
+		bits = number_slow(number, bits);
+
+done:
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+double json_number_value(const struct json_number *number)
+{
+	double value = number->count ? number_convert(number) : 0.0;
+	return number->negative ? -value : value;
+}
+
+size_t json_number_parse_n(const char *str, size_t size, double *value)
+{
+	struct json_number number;
+	const char *p = str;
+	const char *end = str + size;
+
+	json_number_init(&number);
+
+	if (p < end && *p == '-') {
+		number.negative = 1;
+		++p;
+	}
+	if (p == end || *p < '0' || *p > '9')
+		return 0;
+	if (*p == '0')
+		++p;
+	else
+		while (p < end && *p >= '0' && *p <= '9')
+			push_digit(&number, *p++ - '0');
+
+	if (p < end && *p == '.') {
+		const char *fraction = ++p;
+		while (p < end && *p >= '0' && *p <= '9')
+			push_digit(&number, *p++ - '0');
+		if (p == fraction)
+			return 0;
+		number.scale = fraction - p;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		if (++p < end && (*p == '-' || *p == '+'))
+			number.exponent_negative = *p++ == '-';
+		if (p == end || *p < '0' || *p > '9')
+			return 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			if (number.exponent < EXPONENT_LIMIT)
+				number.exponent = number.exponent * 10 + (*p - '0');
+	}
+
+	*value = json_number_value(&number);
+	return (size_t)(p - str);
+}
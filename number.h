@@ -0,0 +1,92 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_NUMBER_H
+#define JONSON_NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Upper bound of the number of characters json_number_format() writes.
+ */
+#define JSON_NUMBER_MAX_SIZE 32
+
+/*
+ * Writes the shortest decimal representation of [value] that reads back
+ * as exactly the same double. Integers below 2^53 are printed as such,
+ * other values the same way JavaScript prints numbers (e.g. "0.1",
+ * "1e+21", "5e-324"). NaN and the infinities have no JSON representation
+ * and are written as "null". Neither stdio nor the locale is used.
+ * [buf] must be able to hold JSON_NUMBER_MAX_SIZE characters, no
+ * terminating NUL is written. Returns the number of characters written.
+ */
+size_t json_number_format(double value, char *buf);
+
+/*
+ * Number of significant digits that are kept for the exact conversion
+ * of numbers with a long mantissa. Anything beyond only matters as a
+ * sticky digit and is not stored.
+ */
+#define JSON_NUMBER_MAX_DIGITS 768
+
+/*
+ * Accumulates a JSON number one character at a time, so it can be fed
+ * from any number of chunks. The first 19 significant digits are kept
+ * in a 64-bit integer, the decimal exponent is tracked separately and
+ * saturates, so the cost of parsing never depends on its magnitude.
+ */
+struct json_number {
+	unsigned int state;
+	int negative;
+	int exponent_negative;
+	int sticky;
+	uint64_t mantissa;
+	size_t count;
+	int64_t scale;
+	int64_t exponent;
+	size_t stored;
+	unsigned char digits[JSON_NUMBER_MAX_DIGITS];
+};
+
+void json_number_init(struct json_number *number);
+
+/*
+ * Feeds the next character to the number. Returns 1 if it continues the
+ * number and 0 if it does not, in which case the character belongs to
+ * the next token and the number is not changed.
+ */
+int json_number_push(struct json_number *number, char c);
+
+/*
+ * Feeds up to [size] characters and returns how many of them continue
+ * the number. Stops at the first one that does not.
+ */
+size_t json_number_push_n(struct json_number *number,
+			  const char *str, size_t size);
+
+/*
+ * Returns 1 if the characters fed so far form a complete JSON number.
+ */
+int json_number_complete(const struct json_number *number);
+
+/*
+ * Converts the accumulated number to the nearest double, rounding ties
+ * to even. Numbers with up to 19 significant digits are converted with
+ * the Eisel-Lemire algorithm, longer or ambiguous ones are resolved
+ * exactly with big integer arithmetic.
+ */
+double json_number_value(const struct json_number *number);
+
+/*
+ * Parses a number that is held in memory as a whole, without going
+ * through json_number_push() for every character. Stores its value and
+ * returns the number of characters it spans, or 0 if [str] does not
+ * start with a valid JSON number.
+ */
+size_t json_number_parse_n(const char *str, size_t size, double *value);
+
+#endif /* JONSON_NUMBER_H */
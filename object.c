@@ -6,11 +6,14 @@
 
 #include "object.h"
 
-#define INIT_LOAD_FACTOR 0.5f
-#define INIT_CAPACITY    16
+#define INIT_CAPACITY    8
 #define FNV_OFFSET_BASIS 2166136261
 #define FNV_PRIME        16777619
 
+/* Index slots that refer to no entry. */
+#define SLOT_EMPTY       0
+#define SLOT_REMOVED     UINT32_MAX
+
 uint32_t json_hash(const char *str)
 {
 	uint32_t hash = FNV_OFFSET_BASIS;
@@ -33,40 +36,185 @@ uint32_t json_hashn(const char *str, size_t size)
 	return hash;
 }
 
-struct json_object *json_object_new(void)
+/*
+ * Rebuilds the index with [slots] slots from the stored hashes.
+ * No key is hashed again.
+ */
+static int rebuild_index(struct json_object *object, size_t slots)
 {
-	struct json_object *object = malloc(sizeof(struct json_object));
-	if (!object)
-		goto error_object;
+	uint32_t *index = json_alloc(object->arena, slots * sizeof(uint32_t));
+	if (!index)
+		return 0;
+	memset(index, 0, slots * sizeof(uint32_t));
 
-	object->load_factor = INIT_LOAD_FACTOR;
-	object->capacity = INIT_CAPACITY;
-	object->size = 0;
+	size_t mask = slots - 1;
+	for (size_t i = 0; i < object->count; ++i) {
+		struct json_entry *entry = object->entries + i;
+		if (!entry->key)
+			continue;
+		size_t slot = entry->hash & mask;
+		while (index[slot] != SLOT_EMPTY)
+			slot = (slot + 1) & mask;
+		index[slot] = (uint32_t)(i + 1);
+	}
 
-	object->buckets = calloc(object->capacity, sizeof(struct json_bucket));
-	if (!object->buckets)
-		goto error_buckets;
+	json_dealloc(object->arena, object->index);
+	object->index = index;
+	object->mask = mask;
+	return 1;
+}
 
-	object->order = malloc(object->capacity * sizeof(size_t));
-	if (!object->order)
-		goto error_order;
+/*
+ * Moves all entries that were not removed to the front.
+ */
+static int compact(struct json_object *object)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < object->count; ++i)
+		if (object->entries[i].key)
+			object->entries[count++] = object->entries[i];
+	object->count = count;
+	return rebuild_index(object, object->mask + 1);
+}
 
-	return object;
+/*
+ * Returns the slot that refers to the key, or to no entry if the key
+ * is not part of the object. The object must have an index.
+ */
+static size_t find_slot(struct json_object *object, const char *key,
+			size_t key_size, uint32_t hash)
+{
+	size_t slot = hash & object->mask;
+	for (;; slot = (slot + 1) & object->mask) {
+		uint32_t reference = object->index[slot];
+		if (reference == SLOT_EMPTY)
+			return slot;
+		if (reference == SLOT_REMOVED)
+			continue;
+		struct json_entry *entry = object->entries + reference - 1;
+		if (entry->hash == hash && entry->key_size == key_size &&
+				memcmp(entry->key, key, key_size) == 0)
+			return slot;
+	}
+}
 
-error_order:
-	free(object->buckets);
-error_buckets:
-	free(object);
-error_object:
+/*
+ * Searches a small object, comparing lengths before contents.
+ */
+static struct json_entry *find_linear(struct json_object *object,
+				      const char *key, size_t key_size)
+{
+	struct json_entry *entry = object->entries;
+	struct json_entry *end = entry + object->count;
+	for (; entry != end; ++entry)
+		if (entry->key_size == key_size &&
+				memcmp(entry->key, key, key_size) == 0)
+			return entry;
 	return NULL;
 }
 
+/*
+ * Searches an object with interned keys for an interned key,
+ * comparing pointers instead of contents.
+ */
+static struct json_entry *find_interned(struct json_object *object,
+					const char *key, uint32_t hash)
+{
+	if (!object->index) {
+		struct json_entry *entry = object->entries;
+		struct json_entry *end = entry + object->count;
+		for (; entry != end; ++entry)
+			if (entry->key == key)
+				return entry;
+		return NULL;
+	}
+
+	size_t slot = hash & object->mask;
+	for (;; slot = (slot + 1) & object->mask) {
+		uint32_t reference = object->index[slot];
+		if (reference == SLOT_EMPTY)
+			return NULL;
+		if (reference != SLOT_REMOVED &&
+				object->entries[reference - 1].key == key)
+			return object->entries + reference - 1;
+	}
+}
+
+static struct json_entry *find_indexed(struct json_object *object,
+				       const char *key, size_t key_size,
+				       uint32_t hash)
+{
+	size_t slot = find_slot(object, key, key_size, hash);
+	if (object->index[slot] == SLOT_EMPTY)
+		return NULL;
+	return object->entries + object->index[slot] - 1;
+}
+
+static struct json_entry *find_entry(struct json_object *object,
+				     const char *key, size_t key_size)
+{
+	if (!object->index)
+		return find_linear(object, key, key_size);
+	return find_indexed(object, key, key_size, json_hashn(key, key_size));
+}
+
+/*
+ * Frees the key of an entry of a heap object if the object owns it.
+ */
+static inline void free_key(struct json_object *object,
+			    struct json_entry *entry)
+{
+	if (!object->keys && !entry->borrowed)
+		free(entry->key);
+}
+
+struct json_object *json_object_new(void)
+{
+	return json_object_new_in(NULL);
+}
+
+struct json_object *json_object_new_in(struct json_arena *arena)
+{
+	return json_object_new_interned(arena, NULL);
+}
+
+struct json_object *json_object_new_interned(struct json_arena *arena,
+					     struct json_intern *keys)
+{
+	struct json_object *object = json_alloc(arena, sizeof(struct json_object) +
+		JSON_OBJECT_INLINE * sizeof(struct json_entry));
+	if (!object)
+		return NULL;
+
+	object->arena = arena;
+	object->keys = keys && !arena ? json_intern_retain(keys) : keys;
+	object->size = 0;
+	object->count = 0;
+	object->capacity = JSON_OBJECT_INLINE;
+	object->mask = 0;
+	object->index = NULL;
+	object->entries = object->small;
+
+	return object;
+}
+
 void json_object_free(struct json_object *object)
 {
-	for (size_t i = 0; i < object->size; ++i)
-		free(object->buckets[object->order[i]].key);
-	free(object->buckets);
-	free(object->order);
+	if (object->arena)
+		return;
+
+	for (size_t i = 0; i < object->count; ++i) {
+		struct json_entry *entry = object->entries + i;
+		if (!entry->key)
+			continue;
+		free_key(object, entry);
+		json_free(entry->value);
+	}
+	if (object->entries != object->small)
+		free(object->entries);
+	free(object->index);
+	if (object->keys)
+		json_intern_release(object->keys);
 	free(object);
 }
 
@@ -74,87 +222,177 @@ int json_object_reserve(struct json_object *object, size_t size)
 {
 	if (size <= object->capacity)
 		return 1;
+	if (size >= UINT32_MAX)
+		return 0;
+
+	struct json_entry *entries;
+	if (object->entries == object->small) {
+		entries = json_alloc(object->arena, size * sizeof(struct json_entry));
+		if (!entries)
+			return 0;
+		memcpy(entries, object->small,
+		       object->count * sizeof(struct json_entry));
+	}
+	else {
+		entries = json_realloc(object->arena, object->entries,
+			object->capacity * sizeof(struct json_entry),
+			size * sizeof(struct json_entry));
+		if (!entries)
+			return 0;
+	}
+	object->entries = entries;
+	object->capacity = size;
+
+	if (size <= JSON_OBJECT_LINEAR)
+		return 1;
 
-	struct json_bucket *buckets = object->buckets;
+	/* The object outgrew linear search, its keys are hashed once. */
+	if (!object->index && !object->keys)
+		for (size_t i = 0; i < object->count; ++i)
+			entries[i].hash = json_hashn(entries[i].key,
+						     entries[i].key_size);
 
-	object->buckets = calloc(size, sizeof(struct json_bucket));
-	if (!object->buckets)
-		goto error_buckets;
+	/* Keep the index at most half full. */
+	size_t slots = object->mask + 1;
+	while (slots < size << 1)
+		slots <<= 1;
+	if (!object->index || slots != object->mask + 1)
+		return rebuild_index(object, slots);
+	return 1;
+}
 
-	object->order = realloc(object->order, size * sizeof(size_t));
-	if (!object->order)
-		goto error_order;
+/*
+ * How set_entry() gets hold of the key of a new entry. Objects with
+ * interned keys intern it first, unless it already is.
+ */
+enum key_mode {
+	KEY_COPY,
+	KEY_BORROW,
+	KEY_OWN,
+	KEY_INTERNED
+};
+
+static int set_entry(struct json_object *object, const char *key,
+		     size_t key_size, uint32_t hash, struct json value,
+		     enum key_mode mode)
+{
+	/* A key that was handed over is freed unless an entry keeps it. */
+	char *owned = mode == KEY_OWN && !object->arena ? (char *)key : NULL;
+	struct json_entry *entry;
+	int added = 0;
 
-	for (size_t i = 0; i < object->size; ++i) {
-		struct json_bucket *bucket = buckets + object->order[i];
-		size_t index = json_hash(bucket->key) % object->capacity;
+	if (key_size >= JSON_BORROW_MAX)
+		goto out;
 
-		for (;; index = (index + 1) % object->capacity) {
-			struct json_bucket *current = object->buckets + index;
-			if (!current->key) {
-				current->key = bucket->key;
-				current->value = bucket->value;
-				object->order[i] = index;
-				break;
-			}
+	if (object->keys) {
+		if (mode != KEY_INTERNED) {
+			key = json_intern_n(object->keys, key, key_size, &hash);
+			if (!key)
+				goto out;
 		}
+		entry = find_interned(object, key, hash);
 	}
+	else
+		entry = find_entry(object, key, key_size);
 
-	object->capacity = size;
-	free(buckets);
-	return 1;
+	if (entry) {
+		if (!object->arena)
+			json_free(entry->value);
+		entry->value = value;
+		added = 1;
+		goto out;
+	}
 
-error_order:
-	free(object->buckets);
-error_buckets:
-	object->buckets = buckets;
-	return 0;
+	if (object->count == object->capacity) {
+		/* Reuse the room of removed entries before growing. */
+		if (object->index && object->size <= object->capacity >> 1) {
+			if (!compact(object))
+				goto out;
+		}
+		else if (!json_object_reserve(object, object->capacity << 1))
+			goto out;
+	}
+
+	entry = object->entries + object->count;
+	entry->borrowed = (mode == KEY_BORROW || mode == KEY_INTERNED) &&
+		!object->keys;
+	if (object->keys || mode != KEY_COPY) {
+		entry->key = (char *)key;
+		if (entry->key == owned)
+			owned = NULL;
+		if (object->index && !object->keys)
+			hash = json_hashn(key, key_size);
+	}
+	else {
+		entry->key = object->arena ?
+			json_arena_strndup(object->arena, key, key_size) :
+			json_strndup(key, key_size);
+		if (!entry->key)
+			goto out;
+		if (object->index)
+			hash = json_hashn(key, key_size);
+	}
+	entry->key_size = (unsigned int)key_size;
+	entry->hash = hash;
+	entry->value = value;
+
+	if (object->index) {
+		size_t slot = find_slot(object, key, key_size, hash);
+		object->index[slot] = (uint32_t)(object->count + 1);
+	}
+	++object->count;
+	++object->size;
+	added = 1;
+
+out:
+	free(owned);
+	return added;
 }
 
 int json_object_set_n(struct json_object *object, const char *key,
-                       size_t key_size, struct json value)
+                      size_t key_size, struct json value)
 {
-	if (object->size >= object->capacity * object->load_factor)
-		if (!json_object_reserve(object, object->capacity << 1))
-			return 0;
-
-	size_t index = json_hashn(key, key_size) % object->capacity;
-
-	for (;; index = (index + 1) % object->capacity) {
-		struct json_bucket *bucket = object->buckets + index;
+	return set_entry(object, key, key_size, 0, value, KEY_COPY);
+}
 
-		if (bucket->key) {
-			if (strncmp(bucket->key, key, key_size) == 0) {
-				json_free(bucket->value);
-				bucket->value = value;
-				return 1;
-			}
-			continue;
-		}
+int json_object_set_borrowed_n(struct json_object *object, const char *key,
+                               size_t key_size, struct json value)
+{
+	return set_entry(object, key, key_size, 0, value, KEY_BORROW);
+}
 
-		bucket->value = value;
-		bucket->key = json_strndup(key, key_size);
-		if (!bucket->key)
-			return 0;
-		break;
-	}
+int json_object_set_owned_n(struct json_object *object, char *key,
+                            size_t key_size, struct json value)
+{
+	return set_entry(object, key, key_size, 0, value, KEY_OWN);
+}
 
-	object->order[object->size++] = index;
-	return 1;
+int json_object_set_interned_n(struct json_object *object, const char *key,
+                               size_t key_size, uint32_t hash,
+                               struct json value)
+{
+	return set_entry(object, key, key_size, hash, value, KEY_INTERNED);
 }
 
 struct json json_object_get_n(struct json_object *object,
                               const char *key, size_t key_size)
 {
-	size_t index = json_hashn(key, key_size) % object->capacity;
+	struct json_entry *entry = find_entry(object, key, key_size);
+	if (!entry)
+		return JSON_NONE;
+	return entry->value;
+}
 
-	for (;; index = (index + 1) % object->capacity) {
-		struct json_bucket *bucket = object->buckets +index;
-		if (!bucket->key)
-			return JSON_NONE;
-		if (strncmp(bucket->key, key, key_size) == 0)
-			return bucket->value;
-	}
+struct json json_object_get_hashed(struct json_object *object,
+                                  const char *key, size_t key_size,
+                                  uint32_t hash)
+{
+	struct json_entry *entry = object->index ?
+		find_indexed(object, key, key_size, hash) :
+		find_linear(object, key, key_size);
+	if (!entry)
+		return JSON_NONE;
+	return entry->value;
 }
 
 enum json_type json_object_try_get_n(struct json_object *object, const char *key,
@@ -163,5 +401,41 @@ enum json_type json_object_try_get_n(struct json_object *object, const char *key
 	struct json value = json_object_get_n(object, key, key_size);
 	if (out_value)
 		*out_value = value;
-	return value.type;
+	return JSON_TYPEOF(value);
+}
+
+int json_object_remove_n(struct json_object *object,
+                         const char *key, size_t key_size)
+{
+	struct json_entry *entry;
+
+	if (!object->index) {
+		entry = find_linear(object, key, key_size);
+		if (!entry)
+			return 0;
+		if (!object->arena) {
+			free_key(object, entry);
+			json_free(entry->value);
+		}
+		/* Small objects stay dense. */
+		memmove(entry, entry + 1, (object->entries + object->count -
+			entry - 1) * sizeof(struct json_entry));
+		--object->count;
+		--object->size;
+		return 1;
+	}
+
+	size_t slot = find_slot(object, key, key_size, json_hashn(key, key_size));
+	if (object->index[slot] == SLOT_EMPTY)
+		return 0;
+
+	entry = object->entries + object->index[slot] - 1;
+	if (!object->arena) {
+		free_key(object, entry);
+		json_free(entry->value);
+	}
+	entry->key = NULL;
+	object->index[slot] = SLOT_REMOVED;
+	--object->size;
+	return 1;
 }
@@ -8,20 +8,61 @@
 #define JONSON_OBJECT_H
 
 #include "jonson.h"
+#include "arena.h"
+#include "intern.h"
 
 #include <stdint.h>
 
+/*
+ * A key-value-pair, as passed to json_build().
+ */
 struct json_bucket {
 	char *key;
 	struct json value;
 };
 
+/*
+ * An entry of an object. Entries are kept in insertion order, removed
+ * ones stay in place with their key set to NULL until the object is
+ * compacted. Keys are NUL-terminated, [key_size] excludes the NUL,
+ * unless they are [borrowed] from memory the object does not own.
+ */
+struct json_entry {
+	char *key;
+	unsigned int key_size : 31;
+	unsigned int borrowed : 1;
+	uint32_t hash;
+	struct json value;
+};
+
+/*
+ * Objects start out with room for JSON_OBJECT_INLINE entries allocated
+ * together with the object itself and are searched linearly while they
+ * hold at most JSON_OBJECT_LINEAR entries. Only larger objects hash
+ * their keys and get an index.
+ */
+#define JSON_OBJECT_INLINE 4
+#define JSON_OBJECT_LINEAR 8
+
+/*
+ * [entries] holds the first [count] entries densely in insertion order,
+ * [size] of them are not removed. [index] is an open addressing table
+ * of [mask] + 1 slots, each referring to an entry by its position + 1.
+ * It is NULL for small objects, which never contain removed entries
+ * and only fill in the hash of their entries if their keys are interned.
+ * [keys] is the pool the keys are interned in, or NULL if the object
+ * owns copies of its keys.
+ */
 struct json_object {
-	float load_factor;
-	size_t capacity;
+	struct json_arena *arena;
+	struct json_intern *keys;
 	size_t size;
-	size_t *order;
-	struct json_bucket *buckets;
+	size_t count;
+	size_t capacity;
+	size_t mask;
+	uint32_t *index;
+	struct json_entry *entries;
+	struct json_entry small[];
 };
 
 uint32_t json_hashn(const char *str, size_t size);
@@ -29,6 +70,22 @@ uint32_t json_hash(const char *str);
 
 struct json_object *json_object_new(void);
 
+/*
+ * Creates an object that allocates itself, its keys and its storage
+ * within [arena]. Such an object is released together with the arena,
+ * json_object_free() does nothing for it. Values stored in it are
+ * expected to belong to the same arena and are not freed either.
+ */
+struct json_object *json_object_new_in(struct json_arena *arena);
+
+/*
+ * Creates an object whose keys are interned in [keys], or owned by the
+ * object if it is NULL. Objects on the heap hold a reference to the
+ * pool, ones within an arena expect it to outlive the arena.
+ */
+struct json_object *json_object_new_interned(struct json_arena *arena,
+					     struct json_intern *keys);
+
 void json_object_free(struct json_object *object);
 
 int json_object_reserve(struct json_object *object, size_t size);
@@ -39,16 +96,74 @@ int json_object_set_n(struct json_object *object, const char *key,
 #define json_object_set(object, key, value) \
         json_object_set_n(object, key, strlen(key), value)
 
+/*
+ * Same as json_object_set_n(), but a new key is referred to instead of
+ * copied, so it has to outlive the object. Objects with interned keys
+ * intern it as usual.
+ */
+int json_object_set_borrowed_n(struct json_object *object, const char *key,
+                               size_t key_size, struct json value);
+
+/*
+ * Same as json_object_set_n(), but a new key is taken over instead of
+ * copied. It has to be allocated in the arena of the object if it has
+ * one, or with malloc() otherwise, in which case it is freed if the
+ * object keeps an earlier copy or on failure.
+ */
+int json_object_set_owned_n(struct json_object *object, char *key,
+                            size_t key_size, struct json value);
+
+/*
+ * Same as json_object_set_n() for a key that is interned in the pool
+ * of the object already, with [hash] as returned by json_intern_n().
+ */
+int json_object_set_interned_n(struct json_object *object, const char *key,
+                               size_t key_size, uint32_t hash,
+                               struct json value);
+
 struct json json_object_get_n(struct json_object *object,
                              const char *key, size_t key_size);
 
 #define json_object_get(object, key) \
         json_object_get_n(object, key, (key) ? strlen(key) : 0)
 
+/*
+ * Looks up a key whose [hash] was computed beforehand with json_hashn(),
+ * so looking up the same key in many objects hashes it only once.
+ */
+struct json json_object_get_hashed(struct json_object *object,
+                                  const char *key, size_t key_size,
+                                  uint32_t hash);
+
 enum json_type json_object_try_get_n(struct json_object *object, const char *key,
                                      size_t key_size, struct json *out_value);
 
 #define json_object_try_get(object, key, out_value) \
         json_object_try_get_n(object, key, (key) ? strlen(key) : 0, out_value)
 
+/*
+ * Removes a key and frees it together with its value, keeping the order
+ * of the remaining entries. Returns 1 if the key was found.
+ */
+int json_object_remove_n(struct json_object *object,
+                         const char *key, size_t key_size);
+
+#define json_object_remove(object, key) \
+        json_object_remove_n(object, key, (key) ? strlen(key) : 0)
+
+/*
+ * Iterates over the entries in insertion order. Start with *position
+ * set to 0, NULL is returned once all entries have been visited.
+ */
+static inline struct json_entry *json_object_next(struct json_object *object,
+                                                  size_t *position)
+{
+	while (*position < object->count) {
+		struct json_entry *entry = object->entries + (*position)++;
+		if (entry->key)
+			return entry;
+	}
+	return NULL;
+}
+
 #endif /* JONSON_OBJECT_H */
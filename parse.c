@@ -0,0 +1,704 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "parse.h"
+#include "escape.h"
+#include "number.h"
+#include "ealloc.h"
+#include "simd.h"
+#include "token.h"
+#include "utf8.h"
+
+#if JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+#define BLOCK_SIZE  64
+#define INIT_FRAMES 32
+
+/*
+ * Masks of the characters of interest in a block, one bit per byte.
+ */
+struct block {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t structural;
+	uint64_t whitespace;
+	uint64_t control;
+	uint64_t high; /* Bytes from 0x80 on */
+};
+
+/*
+ * State that is carried from one block to the next.
+ */
+struct carry {
+	uint64_t escaped;   /* The first byte of the next block is escaped */
+	uint64_t in_string; /* All ones if the block ends within a string */
+	uint64_t scalar;    /* The block ends with a scalar character */
+};
+
+enum {
+	CLASS_QUOTE      = 0x01,
+	CLASS_BACKSLASH  = 0x02,
+	CLASS_STRUCTURAL = 0x04,
+	CLASS_WHITESPACE = 0x08
+};
+
+static const unsigned char classes[256] = {
+	['"']  = CLASS_QUOTE,
+	['\\'] = CLASS_BACKSLASH,
+	['{']  = CLASS_STRUCTURAL,
+	['}']  = CLASS_STRUCTURAL,
+	['[']  = CLASS_STRUCTURAL,
+	[']']  = CLASS_STRUCTURAL,
+	[':']  = CLASS_STRUCTURAL,
+	[',']  = CLASS_STRUCTURAL,
+	[' ']  = CLASS_WHITESPACE,
+	['\t'] = CLASS_WHITESPACE,
+	['\n'] = CLASS_WHITESPACE,
+	['\r'] = CLASS_WHITESPACE
+};
+
+static void classify_scalar(const char *data, struct block *block)
+{
+	uint64_t quote = 0, backslash = 0, structural = 0;
+	uint64_t whitespace = 0, control = 0, high = 0;
+
+	for (int i = 0; i < BLOCK_SIZE; ++i) {
+		unsigned char c = data[i];
+		uint64_t class = classes[c];
+		quote |= (class & 1) << i;
+		backslash |= (class >> 1 & 1) << i;
+		structural |= (class >> 2 & 1) << i;
+		whitespace |= (class >> 3 & 1) << i;
+		control |= (uint64_t)(c < 0x20) << i;
+		high |= (uint64_t)(c >> 7) << i;
+	}
+
+	block->quote = quote;
+	block->backslash = backslash;
+	block->structural = structural;
+	block->whitespace = whitespace;
+	block->control = control;
+	block->high = high;
+}
+
+#if JSON_SIMD_X86
+/*
+ * Structural characters and whitespace are found with two table lookups,
+ * one by the low and one by the high nibble of each byte. A byte is in a
+ * class if both lookups share one of the class' bits:
+ *
+ *   0x01  ','        high 2, low c
+ *   0x02  ':'        high 3, low a
+ *   0x04  '[' ']'    high 5, low b or d
+ *         '{' '}'    high 7, low b or d
+ *   0x08  ' '        high 2, low 0
+ *   0x10  \t \n \r   high 0, low 9, a or d
+ *
+ * Bytes from 0x80 on look up zero in the low table.
+ */
+#define LOW_NIBBLES \
+	0x08, 0, 0, 0, 0, 0, 0, 0, 0, 0x10, 0x12, 0x04, 0x01, 0x14, 0, 0
+#define HIGH_NIBBLES \
+	0x10, 0, 0x09, 0x02, 0, 0x04, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0
+#define STRUCTURAL_BITS 0x07
+#define WHITESPACE_BITS 0x18
+
+JSON_TARGET("sse4.2")
+static void classify_sse42(const char *data, struct block *block)
+{
+	const __m128i low_table = _mm_setr_epi8(LOW_NIBBLES);
+	const __m128i high_table = _mm_setr_epi8(HIGH_NIBBLES);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i structural_bits = _mm_set1_epi8(STRUCTURAL_BITS);
+	const __m128i whitespace_bits = _mm_set1_epi8(WHITESPACE_BITS);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1f);
+	const __m128i zero = _mm_setzero_si128();
+
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < BLOCK_SIZE; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i low = _mm_shuffle_epi8(low_table, v);
+		__m128i high = _mm_shuffle_epi8(high_table,
+			_mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		__m128i class = _mm_and_si128(low, high);
+
+		block->structural |= (uint64_t)(uint16_t)~_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_and_si128(class, structural_bits),
+				       zero)) << i;
+		block->whitespace |= (uint64_t)(uint16_t)~_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_and_si128(class, whitespace_bits),
+				       zero)) << i;
+		block->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, quote)) << i;
+		block->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, backslash)) << i;
+		block->control |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_min_epu8(v, control), v)) << i;
+		block->high |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << i;
+	}
+}
+
+JSON_TARGET("avx2")
+static void classify_avx2(const char *data, struct block *block)
+{
+	const __m256i low_table = _mm256_setr_epi8(LOW_NIBBLES, LOW_NIBBLES);
+	const __m256i high_table = _mm256_setr_epi8(HIGH_NIBBLES, HIGH_NIBBLES);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i structural_bits = _mm256_set1_epi8(STRUCTURAL_BITS);
+	const __m256i whitespace_bits = _mm256_set1_epi8(WHITESPACE_BITS);
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i control = _mm256_set1_epi8(0x1f);
+	const __m256i zero = _mm256_setzero_si256();
+
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < BLOCK_SIZE; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+		__m256i low = _mm256_shuffle_epi8(low_table, v);
+		__m256i high = _mm256_shuffle_epi8(high_table,
+			_mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+		__m256i class = _mm256_and_si256(low, high);
+
+		block->structural |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_and_si256(class, structural_bits),
+					  zero)) << i;
+		block->whitespace |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_and_si256(class, whitespace_bits),
+					  zero)) << i;
+		block->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, quote)) << i;
+		block->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, backslash)) << i;
+		block->control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v)) << i;
+		block->high |= (uint64_t)(uint32_t)_mm256_movemask_epi8(v) << i;
+	}
+}
+#endif
+
+/*
+ * Bit i of the result is the parity of bits 0 to i.
+ */
+static inline uint64_t prefix_xor(uint64_t bits)
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+/*
+ * Returns the characters that follow a backslash which is not escaped
+ * itself. Backslashes are rare, so they are simply visited one by one.
+ */
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t *carry)
+{
+	uint64_t escaped = *carry;
+	*carry = 0;
+
+	backslash &= ~escaped;
+	while (backslash) {
+		int i = json_ctz64(backslash);
+		backslash &= backslash - 1;
+		if (i == 63) {
+			*carry = 1;
+			break;
+		}
+		escaped |= 2ull << i;
+		backslash &= ~(2ull << i);
+	}
+	return escaped;
+}
+
+/*
+ * Appends the offsets of the structural characters, opening quotation
+ * marks and first characters of scalars of a block to the index.
+ * Returns 0 if a string contains an unescaped control character.
+ */
+static ALWAYS_INLINE int index_block(struct json_parser *parser,
+				     struct carry *carry,
+				     const struct block *block, size_t offset)
+{
+	uint64_t escaped = find_escaped(block->backslash, &carry->escaped);
+	uint64_t quote = block->quote & ~escaped;
+	uint64_t in_string = prefix_xor(quote) ^ carry->in_string;
+	carry->in_string = (uint64_t)((int64_t)in_string >> 63);
+
+	if (block->control & in_string) {
+		parser->error = offset + json_ctz64(block->control & in_string);
+		return 0;
+	}
+
+	uint64_t scalar = ~(block->structural | block->whitespace |
+			    block->quote | in_string);
+	uint64_t scalar_start = scalar & ~(scalar << 1 | carry->scalar);
+	carry->scalar = scalar >> 63;
+
+	uint64_t bits = (block->structural & ~in_string) |
+		(quote & in_string) | scalar_start;
+
+	if (parser->count + BLOCK_SIZE > parser->capacity) {
+		parser->capacity = parser->capacity ?
+			parser->capacity << 1 : BLOCK_SIZE * 16;
+		parser->index = erealloc(parser->index, parser->capacity,
+					 sizeof(uint32_t));
+	}
+
+	uint32_t *index = parser->index + parser->count;
+	parser->count += json_popcount64(bits);
+	while (bits) {
+		*index++ = (uint32_t)(offset + json_ctz64(bits));
+		bits &= bits - 1;
+	}
+	return 1;
+}
+
+/*
+ * Validates the UTF-8 of a block while it is still in the cache. Blocks
+ * of ASCII are passed over unless a sequence continues into them.
+ */
+static ALWAYS_INLINE int validate_block(struct json_parser *parser,
+					struct json_utf8 *utf8,
+					const struct block *block,
+					const char *data, size_t size)
+{
+	if (!parser->validate_utf8 ||
+			(!block->high && json_utf8_complete(utf8)))
+		return 1;
+	return json_utf8_feed(utf8, data, size);
+}
+
+/*
+ * Stage one for all blocks of the input, the last one is padded with
+ * whitespace. Returns 0 and sets the error offset on invalid input.
+ */
+static ALWAYS_INLINE int index_input(struct json_parser *parser,
+				     const char *data, size_t size,
+				     void (*classify)(const char *, struct block *))
+{
+	struct carry carry = { 0, 0, 0 };
+	struct json_utf8 utf8;
+	struct block block;
+	size_t offset = 0;
+
+	json_utf8_init(&utf8);
+	for (; offset + BLOCK_SIZE <= size; offset += BLOCK_SIZE) {
+		classify(data + offset, &block);
+		if (!validate_block(parser, &utf8, &block, data + offset,
+				    BLOCK_SIZE))
+			goto invalid_utf8;
+		if (!index_block(parser, &carry, &block, offset))
+			return 0;
+	}
+
+	if (offset < size) {
+		char tail[BLOCK_SIZE];
+		memset(tail, ' ', BLOCK_SIZE);
+		memcpy(tail, data + offset, size - offset);
+		classify(tail, &block);
+		if (!validate_block(parser, &utf8, &block, tail, size - offset))
+			goto invalid_utf8;
+		if (!index_block(parser, &carry, &block, offset))
+			return 0;
+	}
+
+	if (!json_utf8_complete(&utf8)) {
+		parser->error = size;
+		return 0;
+	}
+	if (carry.in_string) {
+		parser->error = size;
+		return 0;
+	}
+	return 1;
+
+invalid_utf8:
+	parser->error = offset;
+	return 0;
+}
+
+static int index_scalar(struct json_parser *parser,
+			const char *data, size_t size)
+{
+	return index_input(parser, data, size, classify_scalar);
+}
+
+#if JSON_SIMD_X86
+JSON_TARGET("sse4.2")
+static int index_sse42(struct json_parser *parser,
+		       const char *data, size_t size)
+{
+	return index_input(parser, data, size, classify_sse42);
+}
+
+JSON_TARGET("avx2")
+static int index_avx2(struct json_parser *parser,
+		      const char *data, size_t size)
+{
+	return index_input(parser, data, size, classify_avx2);
+}
+#endif
+
+static int index_resolve(struct json_parser *parser,
+			 const char *data, size_t size);
+
+static int (*build_index)(struct json_parser *, const char *, size_t) =
+	index_resolve;
+
+static int index_resolve(struct json_parser *parser,
+			 const char *data, size_t size)
+{
+	switch (json_simd_level()) {
+#if JSON_SIMD_X86
+	case JSON_SIMD_AVX2: json_dispatch_store(build_index, index_avx2); break;
+	case JSON_SIMD_SSE42: json_dispatch_store(build_index, index_sse42); break;
+#endif
+	default: json_dispatch_store(build_index, index_scalar); break;
+	}
+	return json_dispatch_load(build_index)(parser, data, size);
+}
+
+/*
+ * Returns 1 if a scalar that ends before [position] is not directly
+ * followed by another character that could be part of it.
+ */
+static inline int scalar_ends(const char *data, size_t size, size_t position)
+{
+	return position == size || (classes[(unsigned char)data[position]] &
+		(CLASS_QUOTE | CLASS_STRUCTURAL | CLASS_WHITESPACE));
+}
+
+/*
+ * Returns the offset of the quotation mark that closes the string
+ * starting at [start]. Stage one made sure there is one.
+ */
+static inline size_t string_end(const char *data, size_t size,
+				size_t start, int *escaped)
+{
+	size_t i = start;
+	for (;;) {
+		i += json_escape_scan(data + i, size - i);
+		if (data[i] == '"')
+			return i;
+		/* A backslash, skip it and the character it escapes. */
+		*escaped = 1;
+		i += 2;
+	}
+}
+
+/*
+ * Strings without escape sequences are borrowed from the input if the
+ * parser was asked to, others are copied and decoded.
+ */
+static struct json parse_string(struct json_parser *parser, const char *data,
+				size_t size, size_t position,
+				struct json_arena *arena)
+{
+	int escaped = 0;
+	size_t start = position + 1;
+	size_t length = string_end(data, size, start, &escaped) - start;
+
+	if (parser->borrow && !escaped && length < JSON_BORROW_MAX)
+		return json_borrow_in(arena, data + start, length);
+
+	char *string = json_alloc(arena, length + 1);
+	if (!string)
+		return JSON_NONE;
+
+	if (escaped) {
+		length = json_unescape_n(string, data + start, length);
+		if (length == JSON_UNESCAPE_ERROR) {
+			json_dealloc(arena, string);
+			return JSON_NONE;
+		}
+	}
+	else
+		memcpy(string, data + start, length);
+	string[length] = 0;
+	return JSON_STRP(string);
+}
+
+/*
+ * Keys without escape sequences are used right from the input,
+ * others are decoded into the scratch buffer.
+ */
+static int parse_key(struct json_parser *parser, const char *data,
+		     size_t size, size_t position,
+		     const char **key, size_t *key_size)
+{
+	int escaped = 0;
+	size_t start = position + 1;
+	size_t length = string_end(data, size, start, &escaped) - start;
+
+	if (!escaped) {
+		*key = data + start;
+		*key_size = length;
+		return 1;
+	}
+
+	strbuffer_reserve(&parser->scratch, length + 1);
+	length = json_unescape_n(parser->scratch.buffer, data + start, length);
+	if (length == JSON_UNESCAPE_ERROR)
+		return 0;
+	*key = parser->scratch.buffer;
+	*key_size = length;
+	return 1;
+}
+
+/*
+ * Adds a value to the innermost container, or makes it the root.
+ * A value that cannot be added is freed.
+ */
+static int add_value(struct json_parser *parser, size_t depth,
+		     struct json *root, const char *key, size_t key_size,
+		     struct json value)
+{
+	if (depth == 0) {
+		*root = value;
+		return 1;
+	}
+
+	struct json container = parser->frames[depth - 1];
+	int added;
+	if (JSON_TYPEOF(container) == JSON_TYPE_ARRAY)
+		added = json_array_add(JSON_ARRVAL(container), value);
+	/* Decoded keys live in the scratch buffer and have to be copied. */
+	else if (parser->borrow && key != parser->scratch.buffer)
+		added = json_object_set_borrowed_n(JSON_OBJVAL(container),
+						   key, key_size, value);
+	else
+		added = json_object_set_n(JSON_OBJVAL(container),
+					  key, key_size, value);
+	if (!added && !parser->document)
+		json_free(value);
+	return added;
+}
+
+static void push_frame(struct json_parser *parser, size_t depth,
+		       struct json container)
+{
+	if (depth == parser->frames_capacity) {
+		parser->frames_capacity = parser->frames_capacity ?
+			parser->frames_capacity << 1 : INIT_FRAMES;
+		parser->frames = erealloc(parser->frames,
+			parser->frames_capacity, sizeof(struct json));
+	}
+	parser->frames[depth] = container;
+}
+
+/*
+ * Stage two: walks the index and builds the values. Containers are
+ * added to their parent as soon as they are opened, so on failure
+ * freeing the root releases everything parsed so far.
+ */
+static struct json build_values(struct json_parser *parser,
+				const char *data, size_t size)
+{
+	struct json_arena *arena =
+		parser->document ? parser->document->arena : NULL;
+	struct json_intern *keys =
+		parser->document ? parser->document->keys : NULL;
+	const uint32_t *index = parser->index;
+	size_t count = parser->count;
+	size_t i = 0;
+	size_t depth = 0;
+	size_t position = size;
+	struct json root = JSON_NONE;
+	struct json value;
+	const char *key = NULL;
+	size_t key_size = 0;
+
+value:
+	if (i == count)
+		goto unexpected_end_of_input;
+	position = index[i++];
+
+	switch (data[position]) {
+	case TOKEN_BEGIN_OBJECT: {
+		struct json_object *object = json_object_new_interned(arena, keys);
+		if (!object || !add_value(parser, depth, &root, key, key_size,
+					  JSON_OBJ(object)))
+			goto error;
+		push_frame(parser, depth++, JSON_OBJ(object));
+		if (i < count && data[index[i]] == TOKEN_END_OBJECT) {
+			++i;
+			--depth;
+			goto after_value;
+		}
+		goto key;
+	}
+	case TOKEN_BEGIN_ARRAY: {
+		struct json_array *array = json_array_new_in(arena);
+		if (!array || !add_value(parser, depth, &root, key, key_size,
+					 JSON_ARR(array)))
+			goto error;
+		push_frame(parser, depth++, JSON_ARR(array));
+		if (i < count && data[index[i]] == TOKEN_END_ARRAY) {
+			++i;
+			--depth;
+			goto after_value;
+		}
+		goto value;
+	}
+	case TOKEN_QUOTATION_MARK:
+		value = parse_string(parser, data, size, position, arena);
+		if (JSON_TYPEOF(value) == JSON_TYPE_NONE)
+			goto error;
+		break;
+	case 't':
+		if (size - position < TOKEN_TRUE_SIZE ||
+				memcmp(data + position, TOKEN_TRUE, TOKEN_TRUE_SIZE) ||
+				!scalar_ends(data, size, position + TOKEN_TRUE_SIZE))
+			goto error;
+		value = JSON_BOOL(1);
+		break;
+	case 'f':
+		if (size - position < TOKEN_FALSE_SIZE ||
+				memcmp(data + position, TOKEN_FALSE, TOKEN_FALSE_SIZE) ||
+				!scalar_ends(data, size, position + TOKEN_FALSE_SIZE))
+			goto error;
+		value = JSON_BOOL(0);
+		break;
+	case 'n':
+		if (size - position < TOKEN_NULL_SIZE ||
+				memcmp(data + position, TOKEN_NULL, TOKEN_NULL_SIZE) ||
+				!scalar_ends(data, size, position + TOKEN_NULL_SIZE))
+			goto error;
+		value = JSON_NULL;
+		break;
+	default: {
+		double number;
+		size_t length = json_number_parse_n(data + position,
+						    size - position, &number);
+		if (!length || !scalar_ends(data, size, position + length))
+			goto error;
+		value = JSON_NUM(number);
+		break;
+	}
+	}
+	if (!add_value(parser, depth, &root, key, key_size, value))
+		goto error;
+
+after_value:
+	if (depth == 0) {
+		if (i != count) {
+			position = index[i];
+			goto error;
+		}
+		return root;
+	}
+	if (i == count)
+		goto unexpected_end_of_input;
+	position = index[i++];
+
+	if (JSON_TYPEOF(parser->frames[depth - 1]) == JSON_TYPE_ARRAY) {
+		if (data[position] == TOKEN_VALUE_SEPARATOR)
+			goto value;
+		if (data[position] == TOKEN_END_ARRAY) {
+			--depth;
+			goto after_value;
+		}
+		goto error;
+	}
+	if (data[position] == TOKEN_END_OBJECT) {
+		--depth;
+		goto after_value;
+	}
+	if (data[position] != TOKEN_VALUE_SEPARATOR)
+		goto error;
+
+key:
+	if (i == count)
+		goto unexpected_end_of_input;
+	position = index[i++];
+	if (data[position] != TOKEN_QUOTATION_MARK ||
+			!parse_key(parser, data, size, position, &key, &key_size))
+		goto error;
+	if (i == count)
+		goto unexpected_end_of_input;
+	position = index[i++];
+	if (data[position] != TOKEN_NAME_SEPARATOR)
+		goto error;
+	goto value;
+
+unexpected_end_of_input:
+	position = size;
+error:
+	parser->error = position;
+	if (!arena)
+		json_free(root);
+	return JSON_NONE;
+}
+
+struct json_parser *json_parser_new(void)
+{
+	return json_parser_new_in(NULL);
+}
+
+struct json_parser *json_parser_new_in(struct json_document *document)
+{
+	struct json_parser *parser = ecalloc(1, sizeof(struct json_parser));
+	parser->document = document;
+	return parser;
+}
+
+void json_parser_free(struct json_parser *parser)
+{
+	free(parser->index);
+	free(parser->frames);
+	free(parser->scratch.buffer);
+	free(parser);
+}
+
+void json_parser_borrow_strings(struct json_parser *parser)
+{
+	parser->borrow = 1;
+}
+
+void json_parser_validate_utf8(struct json_parser *parser)
+{
+	parser->validate_utf8 = 1;
+}
+
+struct json json_parser_parse_n(struct json_parser *parser,
+				const char *data, size_t size)
+{
+	parser->count = 0;
+	parser->error = 0;
+
+	/* Offsets are stored in 32 bits. */
+	if (size > UINT32_MAX)
+		return JSON_NONE;
+
+	if (!json_dispatch_load(build_index)(parser, data, size))
+		return JSON_NONE;
+
+	struct json root = build_values(parser, data, size);
+	if (parser->document && JSON_TYPEOF(root) != JSON_TYPE_NONE)
+		parser->document->root = root;
+	return root;
+}
+
+struct json json_parse_n(const char *data, size_t size)
+{
+	struct json_parser *parser = json_parser_new();
+	struct json root = json_parser_parse_n(parser, data, size);
+	json_parser_free(parser);
+	return root;
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_PARSE_H
+#define JONSON_PARSE_H
+
+#include <stdint.h>
+
+#include "jonson.h"
+#include "strbuffer.h"
+
+/*
+ * Parses JSON text that is held in memory as a whole, in two stages.
+ * The first one classifies the input 64 bytes at a time with the best
+ * vector instructions available and records the offset of every
+ * structural character, string and scalar outside of strings in an
+ * index. The second one walks that index to build the values.
+ *
+ * The input is validated strictly: exactly one value surrounded by
+ * optional whitespace, no control characters within strings and only
+ * valid escape sequences, which are decoded. Inputs must be smaller
+ * than 4 GiB.
+ *
+ * A parser keeps its buffers between calls, so reusing one for many
+ * inputs avoids allocations.
+ */
+struct json_parser {
+	struct json_document *document;
+	uint32_t *index;
+	size_t count;
+	size_t capacity;
+	struct json *frames;
+	size_t frames_capacity;
+	struct strbuffer scratch;
+	size_t error;
+	int borrow;
+	int validate_utf8;
+};
+
+struct json_parser *json_parser_new(void);
+
+/*
+ * Creates a parser that allocates all parsed values within [document],
+ * interning keys if the document has a key pool. A successfully parsed
+ * value becomes the root of the document.
+ */
+struct json_parser *json_parser_new_in(struct json_document *document);
+
+void json_parser_free(struct json_parser *parser);
+
+/*
+ * Makes the parser refer to strings and keys without escape sequences
+ * within the input instead of copying them (see json_borrow_in()), so
+ * the input has to outlive the parsed values. Only the values are
+ * freed by json_free() and document teardown, never the input.
+ */
+void json_parser_borrow_strings(struct json_parser *parser);
+
+/*
+ * Rejects input that is not well-formed UTF-8. The check is done in
+ * stage one, on each block right after it was classified, and skips
+ * blocks of ASCII. The error offset is then the start of the 64 byte
+ * block in which the invalid sequence was detected.
+ */
+void json_parser_validate_utf8(struct json_parser *parser);
+
+/*
+ * Returns the parsed value, or JSON_NONE if [data] is not valid JSON,
+ * in which case the offset at which it was rejected is stored in
+ * the error field of the parser.
+ */
+struct json json_parser_parse_n(struct json_parser *parser,
+				const char *data, size_t size);
+
+/*
+ * Parses [data] with a temporary parser, see json_parser_parse_n().
+ */
+struct json json_parse_n(const char *data, size_t size);
+#define json_parse(data) json_parse_n(data, (data) ? strlen(data) : 0)
+
+#endif /* JONSON_PARSE_H */
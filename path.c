@@ -0,0 +1,243 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "path.h"
+
+/*
+ * Allocates a path with room for [count] steps followed by [keys_size]
+ * characters of keys.
+ */
+static struct json_path *path_new(size_t count, size_t keys_size)
+{
+	struct json_path *path = malloc(sizeof(struct json_path) +
+		count * sizeof(struct json_step) + keys_size);
+	if (!path)
+		return NULL;
+	path->count = 0;
+	return path;
+}
+
+static inline char *path_keys(struct json_path *path, size_t count)
+{
+	return (char *)(path->steps + count);
+}
+
+/*
+ * Parses an array index without leading zeros. Returns 0 if [str] is
+ * not one or does not fit.
+ */
+static int parse_index(const char *str, size_t size, size_t *index)
+{
+	if (!size || (str[0] == '0' && size > 1))
+		return 0;
+
+	size_t value = 0;
+	for (size_t i = 0; i < size; ++i) {
+		if (str[i] < '0' || str[i] > '9')
+			return 0;
+		if (value > (SIZE_MAX - 9) / 10)
+			return 0;
+		value = value * 10 + (size_t)(str[i] - '0');
+	}
+	*index = value;
+	return 1;
+}
+
+static void set_key(struct json_step *step, enum json_step_type type,
+		    const char *key, size_t key_size)
+{
+	step->type = type;
+	step->key = key;
+	step->key_size = key_size;
+	step->hash = json_hashn(key, key_size);
+	step->index = 0;
+}
+
+struct json_path *json_path_compile_pointer_n(const char *pointer,
+					      size_t size)
+{
+	if (size && pointer[0] != '/')
+		return NULL;
+
+	size_t count = 0;
+	for (size_t i = 0; i < size; ++i)
+		if (pointer[i] == '/')
+			++count;
+
+	/* Decoding never makes a token longer, one NUL is added to each. */
+	struct json_path *path = path_new(count, size);
+	if (!path)
+		return NULL;
+	char *keys = path_keys(path, count);
+
+	const char *p = pointer;
+	const char *end = pointer + size;
+	for (; path->count < count; ++path->count) {
+		char *key = keys;
+		for (++p; p != end && *p != '/'; ++p) {
+			if (*p != '~') {
+				*keys++ = *p;
+				continue;
+			}
+			if (++p == end || (*p != '0' && *p != '1'))
+				goto error;
+			*keys++ = *p == '0' ? '~' : '/';
+		}
+		*keys++ = 0;
+
+		struct json_step *step = path->steps + path->count;
+		set_key(step, JSON_STEP_MEMBER, key, keys - key - 1);
+		if (parse_index(key, step->key_size, &step->index))
+			step->type = JSON_STEP_TOKEN;
+	}
+	return path;
+
+error:
+	free(path);
+	return NULL;
+}
+
+struct json_path *json_path_compile_n(const char *str, size_t size)
+{
+	size_t count = size ? 1 : 0;
+	for (size_t i = 0; i < size; ++i)
+		if (str[i] == '.' || str[i] == '[')
+			++count;
+
+	struct json_path *path = path_new(count, size + count);
+	if (!path)
+		return NULL;
+	char *keys = path_keys(path, count);
+
+	const char *p = str;
+	const char *end = str + size;
+	while (p != end) {
+		struct json_step *step = path->steps + path->count++;
+		*step = (struct json_step){ .type = JSON_STEP_WILDCARD };
+
+		if (*p == '[') {
+			const char *start = ++p;
+			while (p != end && *p != ']')
+				++p;
+			if (p == end)
+				goto error;
+			if (p - start != 1 || *start != '*') {
+				if (!parse_index(start, p - start, &step->index))
+					goto error;
+				step->type = JSON_STEP_ELEMENT;
+			}
+			++p;
+		}
+		else {
+			const char *start = p;
+			while (p != end && *p != '.' && *p != '[')
+				++p;
+			if (p == start)
+				goto error;
+			if (p - start != 1 || *start != '*') {
+				memcpy(keys, start, p - start);
+				set_key(step, JSON_STEP_MEMBER, keys, p - start);
+				keys += p - start;
+				*keys++ = 0;
+			}
+		}
+
+		/* Each dot is followed by a name. */
+		if (p == end || *p == '[')
+			continue;
+		if (*p != '.' || ++p == end || *p == '[')
+			goto error;
+	}
+	return path;
+
+error:
+	free(path);
+	return NULL;
+}
+
+void json_path_free(struct json_path *path)
+{
+	free(path);
+}
+
+/*
+ * Follows the steps from [step] on, branching at wildcards, and stores
+ * every value reached at the end after the [count] ones found so far,
+ * stopping once there are [limit]. Returns the new number of values.
+ */
+static size_t match(const struct json_step *step, const struct json_step *end,
+		    struct json value, struct json *results, size_t capacity,
+		    size_t limit, size_t count)
+{
+	for (; step != end; ++step) {
+		enum json_type type = JSON_TYPEOF(value);
+
+		switch (step->type) {
+		case JSON_STEP_WILDCARD:
+			if (type == JSON_TYPE_OBJECT) {
+				struct json_object *object = JSON_OBJVAL(value);
+				struct json_entry *entry;
+				size_t position = 0;
+				while (count < limit &&
+				       (entry = json_object_next(object, &position)))
+					count = match(step + 1, end, entry->value,
+						      results, capacity, limit, count);
+			}
+			else if (type == JSON_TYPE_ARRAY) {
+				struct json_array *array = JSON_ARRVAL(value);
+				for (size_t i = 0; i < array->size &&
+						   count < limit; ++i)
+					count = match(step + 1, end, array->data[i],
+						      results, capacity, limit, count);
+			}
+			return count;
+		case JSON_STEP_TOKEN:
+			if (type == JSON_TYPE_ARRAY) {
+				value = json_array_get(JSON_ARRVAL(value),
+						       step->index);
+				break;
+			}
+			/* fall through */
+		case JSON_STEP_MEMBER:
+			if (type != JSON_TYPE_OBJECT)
+				return count;
+			value = json_object_get_hashed(JSON_OBJVAL(value),
+				step->key, step->key_size, step->hash);
+			break;
+		case JSON_STEP_ELEMENT:
+			if (type != JSON_TYPE_ARRAY)
+				return count;
+			value = json_array_get(JSON_ARRVAL(value), step->index);
+			break;
+		}
+
+		if (JSON_TYPEOF(value) == JSON_TYPE_NONE)
+			return count;
+	}
+
+	if (count < capacity)
+		results[count] = value;
+	return count + 1;
+}
+
+struct json json_path_get(const struct json_path *path, struct json value)
+{
+	struct json result;
+	if (!match(path->steps, path->steps + path->count, value,
+		   &result, 1, 1, 0))
+		return JSON_NONE;
+	return result;
+}
+
+size_t json_path_match(const struct json_path *path, struct json value,
+		       struct json *results, size_t capacity)
+{
+	return match(path->steps, path->steps + path->count, value,
+		     results, capacity, SIZE_MAX, 0);
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_PATH_H
+#define JONSON_PATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jonson.h"
+
+enum json_step_type {
+	JSON_STEP_MEMBER,   /* Member of an object with [key] */
+	JSON_STEP_ELEMENT,  /* Element of an array at [index] */
+	JSON_STEP_TOKEN,    /* Either of them, for JSON pointer tokens */
+	JSON_STEP_WILDCARD  /* Every member or element */
+};
+
+/*
+ * A step of a compiled path. Keys are decoded and hashed with
+ * json_hashn() when the path is compiled.
+ */
+struct json_step {
+	enum json_step_type type;
+	uint32_t hash;
+	size_t key_size;
+	const char *key;
+	size_t index;
+};
+
+/*
+ * A path that was parsed once and can be looked up in any number of
+ * values without allocating. Its steps and keys are allocated as one
+ * block.
+ */
+struct json_path {
+	size_t count;
+	struct json_step steps[];
+};
+
+/*
+ * Compiles an RFC 6901 JSON pointer such as "/items/0/a~1b". Tokens
+ * that are array indices match elements of arrays as well as members
+ * of objects. Returns NULL if the pointer is malformed or on failure.
+ */
+struct json_path *json_path_compile_pointer_n(const char *pointer,
+					      size_t size);
+#define json_path_compile_pointer(pointer) \
+	json_path_compile_pointer_n(pointer, (pointer) ? strlen(pointer) : 0)
+
+/*
+ * Compiles a dotted path such as "items[0].name" or "items[*].tags.*".
+ * Names match members of objects, bracketed indices elements of arrays
+ * and "*" or "[*]" all members or elements. The empty path refers to
+ * the value itself. Returns NULL if the path is malformed or on
+ * failure.
+ */
+struct json_path *json_path_compile_n(const char *path, size_t size);
+#define json_path_compile(path) \
+	json_path_compile_n(path, (path) ? strlen(path) : 0)
+
+void json_path_free(struct json_path *path);
+
+/*
+ * Returns the first value [path] refers to within [value], or JSON_NONE
+ * if there is none.
+ */
+struct json json_path_get(const struct json_path *path, struct json value);
+
+/*
+ * Stores up to [capacity] of the values [path] refers to within [value]
+ * in [results], in document order. Returns the number of values that
+ * matched, which may be larger than [capacity].
+ */
+size_t json_path_match(const struct json_path *path, struct json value,
+		       struct json *results, size_t capacity);
+
+#endif /* JONSON_PATH_H */
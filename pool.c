@@ -0,0 +1,194 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+
+#include "pool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define POOL_THREADS 1
+#else
+#define POOL_THREADS 0
+#endif
+
+unsigned int json_pool_threads(unsigned int threads)
+{
+#if POOL_THREADS
+	if (!threads) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (unsigned int)online : 1;
+	}
+	return threads < JSON_POOL_MAX_THREADS ?
+		threads : JSON_POOL_MAX_THREADS;
+#else
+	return 1;
+#endif
+}
+
+#if POOL_THREADS
+struct run {
+	void (*task)(void *, size_t, unsigned int);
+	void *context;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+struct worker {
+	struct run *run;
+	unsigned int thread;
+};
+
+static void work(struct run *run, unsigned int thread)
+{
+	for (;;) {
+		pthread_mutex_lock(&run->lock);
+		size_t index = run->next;
+		if (index < run->count)
+			++run->next;
+		pthread_mutex_unlock(&run->lock);
+		if (index >= run->count)
+			return;
+		run->task(run->context, index, thread);
+	}
+}
+
+static void *work_once(void *arg)
+{
+	struct worker *worker = arg;
+	work(worker->run, worker->thread);
+	return NULL;
+}
+
+/*
+ * Threads 1 to [started] wait for runs until the process exits. Each
+ * run bumps [generation] and wakes them, those whose number is below
+ * [threads] join it. The run is over once its indices are handed out
+ * and no worker is [active] in it anymore.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	struct run *run;
+	unsigned long generation;
+	unsigned int threads;
+	unsigned int started;
+	unsigned int active;
+} workers = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0, 0
+};
+
+static void *keep_working(void *arg)
+{
+	unsigned int thread = (unsigned int)(uintptr_t)arg;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&workers.lock);
+	for (;;) {
+		while (workers.generation == seen)
+			pthread_cond_wait(&workers.wake, &workers.lock);
+		seen = workers.generation;
+		struct run *run = workers.run;
+		if (!run || thread >= workers.threads)
+			continue;
+
+		++workers.active;
+		pthread_mutex_unlock(&workers.lock);
+		work(run, thread);
+		pthread_mutex_lock(&workers.lock);
+		if (!--workers.active)
+			pthread_cond_signal(&workers.done);
+	}
+	return NULL;
+}
+
+/*
+ * Starts threads for a single run, for runs that overlap with the one
+ * the kept workers are busy with.
+ */
+static void run_once(struct run *run, unsigned int threads)
+{
+	struct worker others[JSON_POOL_MAX_THREADS];
+	pthread_t ids[JSON_POOL_MAX_THREADS];
+
+	unsigned int started = 1;
+	for (; started < threads; ++started) {
+		others[started].run = run;
+		others[started].thread = started;
+		if (pthread_create(ids + started, NULL, work_once,
+				   others + started))
+			break;
+	}
+	work(run, 0);
+
+	for (unsigned int i = 1; i < started; ++i)
+		pthread_join(ids[i], NULL);
+}
+
+void json_pool_run(unsigned int threads, size_t count,
+		   void (*task)(void *context, size_t index,
+				unsigned int thread),
+		   void *context)
+{
+	threads = json_pool_threads(threads);
+	if (threads > count)
+		threads = count ? (unsigned int)count : 1;
+	if (threads == 1) {
+		for (size_t i = 0; i < count; ++i)
+			task(context, i, 0);
+		return;
+	}
+
+	struct run run = { task, context, count, 0,
+			   PTHREAD_MUTEX_INITIALIZER };
+
+	pthread_mutex_lock(&workers.lock);
+	int kept = !workers.run;
+	if (kept) {
+		while (workers.started + 1 < threads) {
+			pthread_t id;
+			void *thread = (void *)(uintptr_t)(workers.started + 1);
+			if (pthread_create(&id, NULL, keep_working, thread))
+				break;
+			pthread_detach(id);
+			++workers.started;
+		}
+		workers.run = &run;
+		workers.threads = threads;
+		++workers.generation;
+		pthread_cond_broadcast(&workers.wake);
+	}
+	pthread_mutex_unlock(&workers.lock);
+
+	/* The calling thread is the first worker. */
+	if (kept) {
+		work(&run, 0);
+		pthread_mutex_lock(&workers.lock);
+		while (workers.active)
+			pthread_cond_wait(&workers.done, &workers.lock);
+		workers.run = NULL;
+		pthread_mutex_unlock(&workers.lock);
+	}
+	else
+		run_once(&run, threads);
+	pthread_mutex_destroy(&run.lock);
+}
+#else
+void json_pool_run(unsigned int threads, size_t count,
+		   void (*task)(void *context, size_t index,
+				unsigned int thread),
+		   void *context)
+{
+	for (size_t i = 0; i < count; ++i)
+		task(context, i, 0);
+}
+#endif
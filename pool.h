@@ -0,0 +1,43 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_POOL_H
+#define JONSON_POOL_H
+
+#include <stddef.h>
+
+/*
+ * The most threads json_pool_run() starts.
+ */
+#define JSON_POOL_MAX_THREADS 256
+
+/*
+ * Returns the number of threads to use for [threads], which is the
+ * number of online processors if it is 0, capped at
+ * JSON_POOL_MAX_THREADS. Always 1 without thread support.
+ */
+unsigned int json_pool_threads(unsigned int threads);
+
+/*
+ * Calls [task] for every index below [count], spread over
+ * json_pool_threads([threads]) threads including the calling one, and
+ * returns once all calls have returned. Indices are handed out one at
+ * a time in ascending order, so threads that are done early take over
+ * the remaining ones. [thread] is below the number of threads and
+ * tells which one runs the call, e.g. to select per-thread state.
+ * Falls back to fewer threads if they cannot be started.
+ *
+ * The threads are started by the first run that needs them and then
+ * wait for the next one, so a run only has to wake them. A run that
+ * overlaps with another one, because it is started concurrently or
+ * from within a task, starts threads of its own instead.
+ */
+void json_pool_run(unsigned int threads, size_t count,
+		   void (*task)(void *context, size_t index,
+				unsigned int thread),
+		   void *context);
+
+#endif /* JONSON_POOL_H */
@@ -0,0 +1,353 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "records.h"
+#include "cursor.h"
+#include "parse.h"
+#include "file.h"
+#include "pool.h"
+#include "token.h"
+
+#define CHUNKS_PER_THREAD 16
+#define MIN_CHUNK_SIZE    (64 * 1024)
+#define INIT_VALUES       64
+
+struct chunk {
+	const char *data;
+	size_t size;
+	struct json_document *document;
+	struct json *values;
+	size_t count;
+	int failed;
+};
+
+struct job {
+	struct chunk *chunks;
+	struct json_parser **parsers;
+	unsigned int flags;
+};
+
+static int add_record(struct chunk *chunk, size_t *capacity,
+		      struct json value)
+{
+	if (chunk->count == *capacity) {
+		*capacity = *capacity ? *capacity << 1 : INIT_VALUES;
+		struct json *values = realloc(chunk->values,
+			*capacity * sizeof(struct json));
+		if (!values)
+			return 0;
+		chunk->values = values;
+	}
+	chunk->values[chunk->count++] = value;
+	return 1;
+}
+
+static void parse_chunk(void *context, size_t index, unsigned int thread)
+{
+	struct job *job = context;
+	struct chunk *chunk = job->chunks + index;
+	size_t capacity = 0;
+
+	chunk->document = json_document_new(job->flags);
+	if (!chunk->document)
+		goto error;
+
+	struct json_parser *parser = job->parsers[thread];
+	if (!parser)
+		parser = job->parsers[thread] = json_parser_new();
+	parser->document = chunk->document;
+
+	const char *line = chunk->data;
+	const char *end = chunk->data + chunk->size;
+	while (line != end) {
+		const char *next = memchr(line, TOKEN_LINE_FEED, end - line);
+		size_t size = next ? (size_t)(next - line) : (size_t)(end - line);
+
+		if (json_token_whitespace(line, size) != size &&
+				!add_record(chunk, &capacity,
+					    json_parser_parse_n(parser, line, size)))
+			goto error;
+		line = next ? next + 1 : end;
+	}
+	return;
+
+error:
+	chunk->failed = 1;
+}
+
+/*
+ * Splits [data] into up to [count] chunks that end after a line feed,
+ * or at the end of the input. Returns the number of chunks.
+ */
+static size_t split(const char *data, size_t size,
+		    struct chunk *chunks, size_t count)
+{
+	size_t target = size / count;
+	if (target < MIN_CHUNK_SIZE)
+		target = MIN_CHUNK_SIZE;
+
+	size_t n = 0;
+	size_t start = 0;
+	while (start < size) {
+		size_t end = size;
+		if (size - start > target) {
+			const char *feed = memchr(data + start + target,
+				TOKEN_LINE_FEED, size - start - target);
+			if (feed)
+				end = feed - data + 1;
+		}
+		chunks[n++] = (struct chunk){ .data = data + start,
+					      .size = end - start };
+		start = end;
+	}
+	return n;
+}
+
+struct json_records *json_parse_records_n(const char *data, size_t size,
+					  unsigned int flags,
+					  unsigned int threads)
+{
+	threads = json_pool_threads(threads);
+
+	struct json_records *records = calloc(1, sizeof(struct json_records));
+	if (!records)
+		return NULL;
+
+	size_t count = (size_t)threads * CHUNKS_PER_THREAD;
+	struct chunk *chunks = calloc(count, sizeof(struct chunk));
+	struct json_parser **parsers =
+		calloc(threads, sizeof(struct json_parser *));
+	records->documents = calloc(count, sizeof(struct json_document *));
+	if (!chunks || !parsers || !records->documents)
+		goto error;
+
+	count = split(data, size, chunks, count);
+	struct job job = { chunks, parsers, flags };
+	json_pool_run(threads, count, parse_chunk, &job);
+
+	int failed = 0;
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i) {
+		failed |= chunks[i].failed;
+		total += chunks[i].count;
+		if (chunks[i].document)
+			records->documents[records->document_count++] =
+				chunks[i].document;
+	}
+
+	records->values = malloc((total ? total : 1) * sizeof(struct json));
+	if (failed || !records->values)
+		goto error;
+	for (size_t i = 0; i < count; ++i) {
+		memcpy(records->values + records->count, chunks[i].values,
+		       chunks[i].count * sizeof(struct json));
+		records->count += chunks[i].count;
+	}
+	goto done;
+
+error:
+	json_records_free(records);
+	records = NULL;
+done:
+	if (chunks)
+		for (size_t i = 0; i < count; ++i)
+			free(chunks[i].values);
+	if (parsers)
+		for (unsigned int i = 0; i < threads; ++i)
+			if (parsers[i])
+				json_parser_free(parsers[i]);
+	free(parsers);
+	free(chunks);
+	return records;
+}
+
+struct elements {
+	const char *data;
+	size_t *bounds; /* Start and end of each element */
+	size_t count;
+	size_t per_range;
+	struct json *values;
+	struct json_document **documents;
+	struct json_parser **parsers;
+	unsigned int flags;
+};
+
+static void parse_range(void *context, size_t index, unsigned int thread)
+{
+	struct elements *job = context;
+	size_t first = index * job->per_range;
+	size_t last = first + job->per_range;
+	if (last > job->count)
+		last = job->count;
+
+	/* Failures are told by an element that is JSON_NONE. */
+	struct json_document *document = json_document_new(job->flags);
+	job->documents[index] = document;
+	if (!document) {
+		job->values[first] = JSON_NONE;
+		return;
+	}
+
+	struct json_parser *parser = job->parsers[thread];
+	if (!parser)
+		parser = job->parsers[thread] = json_parser_new();
+	parser->document = document;
+
+	for (size_t i = first; i < last; ++i) {
+		size_t start = job->bounds[2 * i];
+		job->values[i] = json_parser_parse_n(parser,
+			job->data + start, job->bounds[2 * i + 1] - start);
+		if (JSON_TYPEOF(job->values[i]) == JSON_TYPE_NONE)
+			return;
+	}
+}
+
+/*
+ * Stores the start and end offset of each element of the array in
+ * [data] in [bounds], which is grown as needed. Returns the number of
+ * elements, or SIZE_MAX if the text is not an array.
+ */
+static size_t find_elements(const char *data, size_t size, size_t **bounds)
+{
+	struct json_cursor array, element;
+	size_t capacity = 0;
+	size_t count = 0;
+
+	if (json_cursor_init_n(&array, data, size) != JSON_TYPE_ARRAY)
+		return SIZE_MAX;
+
+	while (json_cursor_array_get(&array, count, &element)) {
+		if (count == capacity) {
+			capacity = capacity ? capacity << 1 : INIT_VALUES;
+			size_t *grown = realloc(*bounds,
+				2 * capacity * sizeof(size_t));
+			if (!grown)
+				return SIZE_MAX;
+			*bounds = grown;
+		}
+		(*bounds)[2 * count] = element.start;
+		(*bounds)[2 * count + 1] = element.end;
+		++count;
+	}
+
+	/* The lookup stops at the closing bracket, at a trailing comma or
+	   at anything malformed. Only the first may end the array. */
+	size_t end = count ? array.next :
+		array.start + 1 + json_token_whitespace(data + array.start + 1,
+						       size - array.start - 1);
+	if (end == size || data[end] != ']' || data[end - 1] == ',')
+		return SIZE_MAX;
+	++end;
+	if (json_token_whitespace(data + end, size - end) != size - end)
+		return SIZE_MAX;
+	return count;
+}
+
+struct json_document *json_parse_array_n(const char *data, size_t size,
+					 unsigned int flags,
+					 unsigned int threads)
+{
+	threads = json_pool_threads(threads);
+
+	struct json_document *document = json_document_new(flags);
+	struct elements job = { .data = data, .flags = flags };
+	size_t ranges = 0;
+	if (!document)
+		return NULL;
+
+	job.count = find_elements(data, size, &job.bounds);
+	if (job.count == SIZE_MAX)
+		goto error;
+
+	struct json_array *array = json_array_new_in(document->arena);
+	if (!array || !json_array_reserve(array, job.count))
+		goto error;
+	job.values = array->data;
+
+	ranges = (size_t)threads * CHUNKS_PER_THREAD;
+	if (ranges > job.count)
+		ranges = job.count;
+	job.per_range = ranges ? (job.count + ranges - 1) / ranges : 0;
+	if (ranges)
+		ranges = (job.count + job.per_range - 1) / job.per_range;
+	job.documents = calloc(ranges ? ranges : 1,
+			       sizeof(struct json_document *));
+	job.parsers = calloc(threads, sizeof(struct json_parser *));
+	if (!job.documents || !job.parsers)
+		goto error;
+
+	json_pool_run(threads, ranges, parse_range, &job);
+	/* A range stops at its first failure, whose element is checked
+	   before any of the ones that were left unset. */
+	for (size_t i = 0; i < job.count; ++i)
+		if (JSON_TYPEOF(job.values[i]) == JSON_TYPE_NONE)
+			goto error;
+
+	/* The elements now belong to the document of the array. */
+	array->size = job.count;
+	document->root = JSON_ARR(array);
+	goto done;
+
+error:
+	json_document_free(document);
+	document = NULL;
+done:
+	if (job.documents)
+		for (size_t i = 0; i < ranges; ++i) {
+			if (!job.documents[i])
+				continue;
+			if (document)
+				json_arena_merge(document->arena,
+						 job.documents[i]->arena);
+			json_document_free(job.documents[i]);
+		}
+	if (job.parsers)
+		for (unsigned int i = 0; i < threads; ++i)
+			if (job.parsers[i])
+				json_parser_free(job.parsers[i]);
+	free(job.parsers);
+	free(job.documents);
+	free(job.bounds);
+	return document;
+}
+
+struct json_document *json_parse_array_file(const char *path,
+					    unsigned int flags,
+					    unsigned int threads)
+{
+	struct json_file file;
+	if (!json_file_open(&file, path))
+		return NULL;
+	struct json_document *document =
+		json_parse_array_n(file.data, file.size, flags, threads);
+	json_file_close(&file);
+	return document;
+}
+
+struct json_records *json_parse_records_file(const char *path,
+					     unsigned int flags,
+					     unsigned int threads)
+{
+	struct json_file file;
+	if (!json_file_open(&file, path))
+		return NULL;
+	struct json_records *records =
+		json_parse_records_n(file.data, file.size, flags, threads);
+	json_file_close(&file);
+	return records;
+}
+
+void json_records_free(struct json_records *records)
+{
+	for (size_t i = 0; i < records->document_count; ++i)
+		json_document_free(records->documents[i]);
+	free(records->documents);
+	free(records->values);
+	free(records);
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_RECORDS_H
+#define JONSON_RECORDS_H
+
+#include <stddef.h>
+
+#include "jonson.h"
+#include "document.h"
+
+/*
+ * The values of newline-delimited JSON text, in input order. Records
+ * that are not valid JSON are JSON_NONE, blank lines are skipped. The
+ * values live within the [documents] and are released with
+ * json_records_free().
+ */
+struct json_records {
+	struct json *values;
+	size_t count;
+	struct json_document **documents;
+	size_t document_count;
+};
+
+/*
+ * Splits [data] into chunks of whole lines and parses them on
+ * [threads] threads, 0 for one per processor (see json_pool_run()).
+ * Each thread reuses its own parser, each chunk gets its own document
+ * created with [flags] (see json_document_new()), so the threads do not
+ * share any allocator. Returns NULL on failure.
+ */
+struct json_records *json_parse_records_n(const char *data, size_t size,
+					  unsigned int flags,
+					  unsigned int threads);
+
+/*
+ * Same as json_parse_records_n() for the file at [path], which is
+ * mapped into memory where possible (see json_file_open()).
+ */
+struct json_records *json_parse_records_file(const char *path,
+					     unsigned int flags,
+					     unsigned int threads);
+
+void json_records_free(struct json_records *records);
+
+/*
+ * Parses JSON text that is a single, possibly huge array on [threads]
+ * threads. The bounds of its elements are found first by skipping over
+ * them like json_cursor does, which only looks at brackets and strings.
+ * Then ranges of elements are parsed concurrently and stored straight
+ * into an array that is sized once. Returns a document created with
+ * [flags] whose root is that array, which is the same for any number
+ * of threads, or NULL if the text is not an array of valid values or
+ * on failure.
+ */
+struct json_document *json_parse_array_n(const char *data, size_t size,
+					 unsigned int flags,
+					 unsigned int threads);
+
+/*
+ * Same as json_parse_array_n() for the file at [path].
+ */
+struct json_document *json_parse_array_file(const char *path,
+					    unsigned int flags,
+					    unsigned int threads);
+
+#endif /* JONSON_RECORDS_H */
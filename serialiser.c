@@ -0,0 +1,230 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "serialiser.h"
+#include "object.h"
+#include "array.h"
+#include "escape.h"
+#include "ealloc.h"
+
+#define INIT_FRAMES 16
+
+struct json_serialiser *json_serialiser_new(struct json value)
+{
+	struct json_serialiser *serialiser =
+		ecalloc(1, sizeof(struct json_serialiser));
+	serialiser->state = JSONW_VALUE;
+	serialiser->value = value;
+	return serialiser;
+}
+
+void json_serialiser_free(struct json_serialiser *serialiser)
+{
+	free(serialiser->frames);
+	free(serialiser);
+}
+
+static inline void set_pending(struct json_serialiser *serialiser,
+			       const char *str, size_t size)
+{
+	memcpy(serialiser->pending, str, size);
+	serialiser->pending_size = size;
+	serialiser->pending_position = 0;
+}
+
+static void begin_string(struct json_serialiser *serialiser,
+			 const char *string, size_t size, char suffix,
+			 enum JSON_SERIALISER_STATE after)
+{
+	serialiser->string = string;
+	serialiser->string_size = size;
+	serialiser->string_position = 0;
+	serialiser->suffix = suffix;
+	serialiser->after_string = after;
+	serialiser->state = JSONW_STRING;
+}
+
+static void push_frame(struct json_serialiser *serialiser,
+		       struct json container)
+{
+	if (serialiser->depth == serialiser->capacity) {
+		serialiser->capacity = serialiser->capacity ?
+			serialiser->capacity << 1 : INIT_FRAMES;
+		serialiser->frames = erealloc(serialiser->frames,
+			serialiser->capacity, sizeof(*serialiser->frames));
+	}
+	struct json_serialiser_frame *frame =
+		serialiser->frames + serialiser->depth++;
+	frame->container = container;
+	frame->index = 0;
+	frame->started = 0;
+}
+
+/*
+ * Prepares a scalar or the opening bracket of a container. Strings are
+ * only started, their body is written by write_string().
+ */
+static void begin_value(struct json_serialiser *serialiser)
+{
+	struct json value = serialiser->value;
+
+	serialiser->state = JSONW_CHILD;
+
+	switch (JSON_TYPEOF(value)) {
+	case JSON_TYPE_NONE:
+	case JSON_TYPE_NULL:
+		set_pending(serialiser, "null", 4);
+		break;
+	case JSON_TYPE_STRING:
+		set_pending(serialiser, "\"", 1);
+		begin_string(serialiser, JSON_STRVAL(value),
+			     JSON_STRLEN(value), 0, JSONW_CHILD);
+		break;
+	case JSON_TYPE_NUMBER:
+		serialiser->pending_size = json_number_format(
+			JSON_NUMVAL(value), serialiser->pending);
+		serialiser->pending_position = 0;
+		break;
+	case JSON_TYPE_BOOLEAN:
+		if (JSON_BOOLVAL(value))
+			set_pending(serialiser, "true", 4);
+		else
+			set_pending(serialiser, "false", 5);
+		break;
+	case JSON_TYPE_OBJECT:
+		if (JSON_OBJVAL(value)->size == 0) {
+			set_pending(serialiser, "{}", 2);
+			break;
+		}
+		set_pending(serialiser, "{", 1);
+		push_frame(serialiser, value);
+		break;
+	case JSON_TYPE_ARRAY:
+		if (JSON_ARRVAL(value)->size == 0) {
+			set_pending(serialiser, "[]", 2);
+			break;
+		}
+		set_pending(serialiser, "[", 1);
+		push_frame(serialiser, value);
+		break;
+	}
+}
+
+/*
+ * Moves on to the next child of the innermost open container, or
+ * closes it if there is none left.
+ */
+static void next_child(struct json_serialiser *serialiser)
+{
+	if (serialiser->depth == 0) {
+		serialiser->state = JSONW_DONE;
+		return;
+	}
+
+	struct json_serialiser_frame *frame =
+		serialiser->frames + serialiser->depth - 1;
+
+	if (JSON_TYPEOF(frame->container) == JSON_TYPE_ARRAY) {
+		struct json_array *array = JSON_ARRVAL(frame->container);
+		if (frame->index < array->size) {
+			serialiser->value = array->data[frame->index];
+			serialiser->state = JSONW_VALUE;
+			if (frame->index++ > 0)
+				set_pending(serialiser, ",", 1);
+			return;
+		}
+		set_pending(serialiser, "]", 1);
+	}
+	else {
+		struct json_object *object = JSON_OBJVAL(frame->container);
+		struct json_entry *entry =
+			json_object_next(object, &frame->index);
+		if (entry) {
+			serialiser->value = entry->value;
+			if (frame->started)
+				set_pending(serialiser, ",\"", 2);
+			else
+				set_pending(serialiser, "\"", 1);
+			frame->started = 1;
+			begin_string(serialiser, entry->key, entry->key_size,
+				     ':', JSONW_VALUE);
+			return;
+		}
+		set_pending(serialiser, "}", 1);
+	}
+	--serialiser->depth;
+}
+
+/*
+ * Copies the body of the current string up to the next character that
+ * has to be escaped, whose escape sequence is left pending.
+ */
+static size_t write_string(struct json_serialiser *serialiser,
+			   char *buffer, size_t size)
+{
+	size_t rest = serialiser->string_size - serialiser->string_position;
+	const char *str = serialiser->string + serialiser->string_position;
+
+	if (rest == 0) {
+		serialiser->pending[0] = '"';
+		serialiser->pending[1] = serialiser->suffix;
+		serialiser->pending_size = serialiser->suffix ? 2 : 1;
+		serialiser->pending_position = 0;
+		serialiser->state = serialiser->after_string;
+		return 0;
+	}
+
+	size_t limit = rest < size ? rest : size;
+	size_t run = json_escape_scan(str, limit);
+	memcpy(buffer, str, run);
+	serialiser->string_position += run;
+	if (run < limit) {
+		serialiser->pending_size =
+			json_escape_char(serialiser->pending, str[run]);
+		serialiser->pending_position = 0;
+		++serialiser->string_position;
+	}
+	return run;
+}
+
+size_t json_serialiser_next(struct json_serialiser *serialiser,
+			    char *buffer, size_t size)
+{
+	size_t written = 0;
+
+	for (;;) {
+		size_t pending = serialiser->pending_size -
+			serialiser->pending_position;
+		if (pending) {
+			if (pending > size - written)
+				pending = size - written;
+			memcpy(buffer + written, serialiser->pending +
+			       serialiser->pending_position, pending);
+			serialiser->pending_position += pending;
+			written += pending;
+		}
+		if (written == size)
+			return written;
+
+		switch (serialiser->state) {
+		case JSONW_VALUE:
+			begin_value(serialiser);
+			break;
+		case JSONW_CHILD:
+			next_child(serialiser);
+			break;
+		case JSONW_STRING:
+			written += write_string(serialiser, buffer + written,
+						size - written);
+			break;
+		case JSONW_DONE:
+			return written;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_SERIALISER_H
+#define JONSON_SERIALISER_H
+
+#include <stddef.h>
+
+#include "jonson.h"
+#include "number.h"
+
+enum JSON_SERIALISER_STATE {
+	JSONW_VALUE,  /* The next value is written */
+	JSONW_CHILD,  /* The next child of the innermost container follows */
+	JSONW_STRING, /* A string or key is being written */
+	JSONW_DONE
+};
+
+struct json_serialiser_frame {
+	struct json container;
+	size_t index;
+	int started;
+};
+
+/*
+ * Serialises a value piece by piece into buffers provided by the
+ * caller, e.g. whenever a non-blocking socket becomes writable. Only
+ * the containers that are currently open are remembered, so memory
+ * use depends on the nesting depth and not on the size of the value.
+ * The value must not be modified while it is serialised.
+ */
+struct json_serialiser {
+	enum JSON_SERIALISER_STATE state;
+	enum JSON_SERIALISER_STATE after_string;
+	struct json value;
+	struct json_serialiser_frame *frames;
+	size_t depth;
+	size_t capacity;
+	const char *string;
+	size_t string_size;
+	size_t string_position;
+	char suffix;
+	char pending[JSON_NUMBER_MAX_SIZE];
+	size_t pending_size;
+	size_t pending_position;
+};
+
+struct json_serialiser *json_serialiser_new(struct json value);
+void json_serialiser_free(struct json_serialiser *serialiser);
+
+/*
+ * Writes as much of the serialised value as fits into [size] bytes of
+ * [buffer], continuing where the previous call stopped. Returns the
+ * number of bytes written, which is less than [size] only once the
+ * end is reached. No terminating NUL is written.
+ */
+size_t json_serialiser_next(struct json_serialiser *serialiser,
+			    char *buffer, size_t size);
+
+/*
+ * Returns 1 once the whole value has been written.
+ */
+static inline int json_serialiser_done(const struct json_serialiser *serialiser)
+{
+	return serialiser->state == JSONW_DONE &&
+		serialiser->pending_position == serialiser->pending_size;
+}
+
+#endif /* JONSON_SERIALISER_H */
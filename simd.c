@@ -0,0 +1,40 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "simd.h"
+
+/* The detected level, or -1 until it is known. */
+static int detected = -1;
+static enum json_simd limit = JSON_SIMD_AVX2;
+
+static enum json_simd detect(void)
+{
+#if JSON_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return JSON_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return JSON_SIMD_SSE42;
+	if (__builtin_cpu_supports("sse2"))
+		return JSON_SIMD_SSE2;
+#endif
+	return JSON_SIMD_NONE;
+}
+
+enum json_simd json_simd_level(void)
+{
+	int level = json_dispatch_load(detected);
+	if (level < 0) {
+		level = detect();
+		json_dispatch_store(detected, level);
+	}
+	return (enum json_simd)level < limit ? (enum json_simd)level : limit;
+}
+
+void json_simd_set_level(enum json_simd max)
+{
+	limit = max;
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_SIMD_H
+#define JONSON_SIMD_H
+
+/*
+ * Vectorised kernels are only built for x86 with GCC compatible compilers,
+ * which allow enabling instruction sets per function. Everything else uses
+ * the portable code paths. Define JSON_NO_SIMD to force those everywhere.
+ */
+#if !defined(JSON_NO_SIMD) && defined(__GNUC__) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define JSON_SIMD_X86 1
+#define JSON_TARGET(isa) __attribute__((target(isa)))
+#else
+#define JSON_SIMD_X86 0
+#endif
+
+enum json_simd {
+	JSON_SIMD_NONE,
+	JSON_SIMD_SSE2,
+	JSON_SIMD_SSE42,
+	JSON_SIMD_AVX2
+};
+
+/*
+ * Returns the best instruction set extension that is supported by the CPU
+ * the program is running on. The result is detected once and then cached.
+ */
+enum json_simd json_simd_level(void);
+
+/*
+ * Restricts the kernels that are selected to at most [level].
+ * Mainly useful to compare the results of the different code paths.
+ * Has to be called before any other function of the library is used.
+ */
+void json_simd_set_level(enum json_simd level);
+
+#if defined(__GNUC__)
+#define json_ctz32(x) __builtin_ctz(x)
+#define json_ctz64(x) __builtin_ctzll(x)
+#define json_clz64(x) __builtin_clzll(x)
+#define json_popcount64(x) __builtin_popcountll(x)
+#else
+static inline int json_ctz32(unsigned int x)
+{
+	int n = 0;
+	while (!(x & 1)) {
+		x >>= 1;
+		++n;
+	}
+	return n;
+}
+
+static inline int json_ctz64(unsigned long long x)
+{
+	int n = 0;
+	while (!(x & 1)) {
+		x >>= 1;
+		++n;
+	}
+	return n;
+}
+
+static inline int json_clz64(unsigned long long x)
+{
+	int n = 0;
+	while (!(x & (1ull << 63))) {
+		x <<= 1;
+		++n;
+	}
+	return n;
+}
+
+static inline int json_popcount64(unsigned long long x)
+{
+	int n = 0;
+	for (; x; x &= x - 1)
+		++n;
+	return n;
+}
+#endif
+
+/*
+ * Kernels are selected on first use and stored in a function pointer.
+ * Threads may race to do so, which is harmless as they all store the
+ * same one, but the accesses are made atomic to say so.
+ */
+#if defined(__GNUC__)
+#define json_dispatch_load(fn) __atomic_load_n(&(fn), __ATOMIC_RELAXED)
+#define json_dispatch_store(fn, kernel) \
+	__atomic_store_n(&(fn), kernel, __ATOMIC_RELAXED)
+#else
+#define json_dispatch_load(fn) (fn)
+#define json_dispatch_store(fn, kernel) ((fn) = (kernel))
+#endif
+
+#endif /* JONSON_SIMD_H */
@@ -9,61 +9,102 @@
 #include "stack.h"
 #include "ealloc.h"
 
-void json_stack_free(struct json_stack *stack, int plates)
+#define INIT_FRAMES 16
+
+/*
+ * Frees the key of a frame if it is on the heap, i.e. its object
+ * neither interns its keys nor lives in an arena.
+ */
+static void free_key(struct json_stack_frame *frame)
 {
-	struct json_stack_node *current = stack->top;
-	while (current) {
-		if (plates)
-			json_free(current->data);
-		struct json_stack_node *next = current->next;
-		free(current);
-		current = next;
-	}
-	free(stack);
+	if (!frame->key)
+		return;
+
+	struct json_object *object = JSON_OBJVAL(frame->container);
+	if (!object->keys && !object->arena)
+		free(frame->key);
+	frame->key = NULL;
 }
 
-void json_stack_push(struct json_stack *stack, struct json value)
+struct json_stack *json_stack_new(void)
 {
-	struct json_stack_node *plate =
-		emalloc(1, sizeof(struct json_stack_node));
-	plate->data = value;
-	plate->next = stack->top;
-	stack->top = plate;
+	struct json_stack *stack = ecalloc(1, sizeof(struct json_stack));
+	stack->max_depth = JSON_STACK_MAX_DEPTH;
+	stack->root = JSON_NONE;
+	return stack;
 }
 
-struct json json_stack_pop(struct json_stack *stack)
+void json_stack_free(struct json_stack *stack, int values)
 {
-	if (!stack->top)
-		return JSON_NONE;
-	struct json_stack_node *top = stack->top;
-	struct json data = top->data;
-	stack->top = top->next;
-	free(top);
-	return data;
+	for (size_t i = 0; i < stack->depth; ++i)
+		free_key(stack->frames + i);
+	if (values)
+		json_free(stack->root);
+	free(stack->frames);
+	free(stack);
 }
 
-int json_stack_end_array(struct json_stack *stack)
+int json_stack_push(struct json_stack *stack, char type,
+		    struct json container)
 {
-	if (JSON_STACK_SEQUENCE_AV(stack->top)) {
-		struct json value = json_stack_pop(stack);
-		struct json_array *array = JSON_ARRVAL(stack->top->data);
-		json_array_add(array, value);
-		stack->top->ready = 1;
-		return 1;
+	if (stack->depth == stack->max_depth)
+		return 0;
+
+	if (stack->depth == stack->capacity) {
+		stack->capacity = stack->capacity ?
+			stack->capacity << 1 : INIT_FRAMES;
+		stack->frames = erealloc(stack->frames, stack->capacity,
+					 sizeof(struct json_stack_frame));
 	}
-	return 0;
+
+	struct json_stack_frame *frame = stack->frames + stack->depth++;
+	frame->type = type;
+	frame->container = container;
+	frame->key = NULL;
+	frame->key_size = 0;
+	return 1;
+}
+
+void json_stack_set_key(struct json_stack *stack, char *key, size_t size,
+			uint32_t hash)
+{
+	struct json_stack_frame *frame = stack->frames + stack->depth - 1;
+	free_key(frame);
+	frame->key = key;
+	frame->key_size = size;
+	frame->key_hash = hash;
 }
 
-int json_stack_end_object(struct json_stack *stack)
+int json_stack_add(struct json_stack *stack, struct json value)
 {
-	if (JSON_STACK_SEQUENCE_OKV(stack->top)) {
-		struct json value = json_stack_pop(stack);
-		char *key = JSON_STRVAL(json_stack_pop(stack));
-		struct json_object *object = JSON_OBJVAL(stack->top->data);
-		json_object_set(object, key, value);
-		stack->top->ready = 1;
-		free(key);
+	if (!stack->depth) {
+		stack->root = value;
 		return 1;
 	}
-	return 0;
+
+	struct json_stack_frame *frame = stack->frames + stack->depth - 1;
+	struct json_arena *arena;
+	int added;
+	if (JSON_TYPEOF(frame->container) == JSON_TYPE_ARRAY) {
+		struct json_array *array = JSON_ARRVAL(frame->container);
+		added = json_array_add(array, value);
+		arena = array->arena;
+	}
+	else {
+		struct json_object *object = JSON_OBJVAL(frame->container);
+		/* The key is handed over, the object frees it if need be. */
+		added = object->keys ?
+			json_object_set_interned_n(object, frame->key,
+						   frame->key_size,
+						   frame->key_hash, value) :
+			json_object_set_owned_n(object, frame->key,
+						frame->key_size, value);
+		arena = object->arena;
+		frame->key = NULL;
+	}
+
+	/* Values within a document are released along with it. */
+	if (!added && !arena)
+		json_free(value);
+	return added;
 }
@@ -9,41 +9,78 @@
 
 #include "jonson.h"
 
-struct json_stack_node {
-	int ready;
-	struct json data;
-	struct json_stack_node *next;
+/*
+ * Default limit of the nesting depth of a stream.
+ */
+#define JSON_STACK_MAX_DEPTH 1024
+
+/*
+ * An object or array that is open while a stream is parsed. [type] is
+ * its opening bracket. [container] is JSON_NONE for streams that report
+ * events instead of building values. [key] is the decoded key of the
+ * next member of an object, stored the way the object keeps its keys:
+ * interned in its pool with [key_hash], in its arena, or on the heap
+ * for the object to take over.
+ */
+struct json_stack_frame {
+	char type;
+	struct json container;
+	char *key;
+	size_t key_size;
+	uint32_t key_hash;
 };
 
+/*
+ * The containers that are open, innermost last, in one array that
+ * grows as needed. Values are added to their parent as soon as they
+ * start, so [root] holds everything that was parsed so far.
+ */
 struct json_stack {
-	struct json_stack_node *top;
+	struct json_stack_frame *frames;
+	size_t depth;
+	size_t capacity;
+	size_t max_depth;
+	struct json root;
 };
 
-static inline struct json_stack *json_stack_new(void)
-{
-	struct json_stack *stack = calloc(1, sizeof(struct json_stack));
-	return stack ? stack : NULL;
-}
+struct json_stack *json_stack_new(void);
 
-void json_stack_free(struct json_stack *stack, int plates);
+/*
+ * Frees the stack and the keys of its frames, as well as [root] if
+ * [values] is set.
+ */
+void json_stack_free(struct json_stack *stack, int values);
 
-void json_stack_push(struct json_stack *stack, struct json value);
-struct json json_stack_pop(struct json_stack *stack);
+/*
+ * Opens a container. Returns 0 if that would nest deeper than
+ * [max_depth].
+ */
+int json_stack_push(struct json_stack *stack, char type,
+		    struct json container);
 
-int json_stack_end_array(struct json_stack *stack);
-int json_stack_end_object(struct json_stack *stack);
+static inline void json_stack_pop(struct json_stack *stack)
+{
+	--stack->depth;
+}
 
-/* Array->value sequence */
-#define JSON_STACK_SEQUENCE_AV(node) \
-	((node) && (node)->next && (node)->next->data.type == JSON_TYPE_ARRAY)
+static inline int json_stack_within(const struct json_stack *stack, char type)
+{
+	return stack->depth && stack->frames[stack->depth - 1].type == type;
+}
 
-/* Object->key sequence */
-#define JSON_STACK_SEQUENCE_OK(node) \
-	((node) && (node)->next && (node)->data.type == JSON_TYPE_STRING && \
-		(node)->next->data.type == JSON_TYPE_OBJECT)
+/*
+ * Sets the key of the next member of the innermost object, allocated
+ * as described for struct json_stack_frame. [hash] is only used for
+ * interned keys. A key on the heap is owned by the stack until the
+ * member is added.
+ */
+void json_stack_set_key(struct json_stack *stack, char *key, size_t size,
+			uint32_t hash);
 
-/* Object->key->value sequence */
-#define JSON_STACK_SEQUENCE_OKV(node) \
-	((node) && JSON_STACK_SEQUENCE_OK((node)->next))
+/*
+ * Adds a value to the innermost container, or makes it the root.
+ * Returns 0 on failure, in which case a value on the heap is freed.
+ */
+int json_stack_add(struct json_stack *stack, struct json value);
 
 #endif /* JSON_STACK_H */
@@ -13,15 +13,7 @@ void strbuffer_reserve(struct strbuffer *sb, size_t size)
 	if (!sb || size <= sb->capacity)
 		return;
 
-	char *new_buffer = ecalloc(size, sizeof(char));
-	if (sb->buffer) {
-		size_t i;
-		for (i = 0; i < sb->size; ++i)
-			new_buffer[i] = sb->buffer[i];
-	}
-
-	free(sb->buffer);
-	sb->buffer = new_buffer;
+	sb->buffer = erealloc(sb->buffer, size, sizeof(char));
 	sb->capacity = size;
 }
 
@@ -35,7 +27,7 @@ size_t strbuffer_insertn(struct strbuffer *sb, size_t index,
 	if (capacity > sb->capacity)
 		strbuffer_reserve(sb, capacity << 1);
 
-	memcpy(sb->buffer + index + size, sb->buffer + index,
+	memmove(sb->buffer + index + size, sb->buffer + index,
 		(sb->size - index) * sizeof(char));
 	memcpy(sb->buffer + index, str, size * sizeof(char));
 	sb->size += size;
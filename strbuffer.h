@@ -48,6 +48,18 @@ char* strbuffer_to_string(struct strbuffer *sb)
 
 void strbuffer_reserve(struct strbuffer *sb, size_t size);
 
+/*
+ * Makes sure [size] more characters can be appended without another
+ * allocation. Unlike strbuffer_reserve(), the capacity grows
+ * geometrically, so repeated calls stay amortised constant.
+ */
+static inline
+void strbuffer_ensure(struct strbuffer *sb, size_t size)
+{
+	if (sb->size + size > sb->capacity)
+		strbuffer_reserve(sb, (sb->size + size) << 1);
+}
+
 size_t strbuffer_insertn(struct strbuffer *sb, size_t index,
 			 const char *str, size_t size);
 #define strbuffer_insert(sb, index, str) \
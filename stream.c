@@ -4,163 +4,397 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "stream.h"
 
-static double precision_table[17] = {
-	[1] = 1e-1, [2] = 1e-2, [3] = 1e-3,
-	[4] = 1e-4, [5] = 1e-5, [6] = 1e-6,
-	[7] = 1e-7, [8] = 1e-8, [9] = 1e-9,
-	[10] = 1e-10, [11] = 1e-11, [12] = 1e-12,
-	[13] = 1e-13, [14] = 1e-14, [15] = 1e-15,
-	[16] = 1e-16
-};
-
 struct json_stream *json_stream_new(void)
+{
+	return json_stream_new_in(NULL);
+}
+
+struct json_stream *json_stream_new_in(struct json_document *document)
 {
 	struct json_stream *stream = ecalloc(1, sizeof(struct json_stream));
 	json_token_init(&stream->token);
-	stream->chain = chain_new();
+	stream->document = document;
 	stream->stack = json_stack_new();
 	return stream;
 }
 
 void json_stream_free(struct json_stream *stream)
 {
-	chain_free(stream->chain);
-	json_stack_free(stream->stack, 1);
+	free(stream->partial.buffer);
+	if (stream->keys)
+		json_intern_release(stream->keys);
+	/* Values of a document are released together with it. */
+	json_stack_free(stream->stack, !stream->document);
 	free(stream);
 }
 
+int json_stream_intern_keys(struct json_stream *stream)
+{
+	if (stream->keys)
+		return 1;
+
+	if (stream->document) {
+		if (!json_document_intern_keys(stream->document))
+			return 0;
+		stream->keys = json_intern_retain(stream->document->keys);
+	}
+	else
+		stream->keys = json_intern_new();
+	return stream->keys != NULL;
+}
+
+void json_stream_set_callbacks(struct json_stream *stream,
+			       const struct json_stream_callbacks *callbacks,
+			       void *user)
+{
+	stream->callbacks = callbacks;
+	stream->user = user;
+}
+
+void json_stream_set_max_depth(struct json_stream *stream, size_t depth)
+{
+	stream->stack->max_depth = depth;
+}
+
+void json_stream_validate_utf8(struct json_stream *stream)
+{
+	stream->validate_utf8 = 1;
+}
+
+void json_stream_set_multiple(struct json_stream *stream,
+			      int (*value)(void *user, struct json value),
+			      void *user)
+{
+	stream->multiple = 1;
+	stream->value = value;
+	stream->user = user;
+}
+
+static inline struct json_arena *stream_arena(struct json_stream *stream)
+{
+	return stream->document ? stream->document->arena : NULL;
+}
+
+/*
+ * Opens an object or array, which is added to its parent right away
+ * when values are built. Returns 0 if it would be nested too deep or
+ * on failure.
+ */
+static int stream_open(struct json_stream *stream, char c)
+{
+	struct json container = JSON_NONE;
+
+	if (stream->stack->depth == stream->stack->max_depth)
+		return 0;
+
+	if (!stream->callbacks) {
+		struct json_arena *arena = stream_arena(stream);
+		if (c == TOKEN_BEGIN_ARRAY) {
+			struct json_array *array = json_array_new_in(arena);
+			if (!array)
+				return 0;
+			container = JSON_ARR(array);
+		}
+		else {
+			struct json_object *object =
+				json_object_new_interned(arena, stream->keys);
+			if (!object)
+				return 0;
+			container = JSON_OBJ(object);
+		}
+		if (!json_stack_add(stream->stack, container))
+			return 0;
+	}
+	return json_stack_push(stream->stack, c, container);
+}
+
+static inline int stream_within(struct json_stream *stream, char c)
+{
+	return json_stack_within(stream->stack, c);
+}
+
+/* Values within objects have to follow a name separator. */
+static inline int stream_value_allowed(struct json_stream *stream,
+				       enum JSON_TOKEN last_token)
+{
+	return !stream_within(stream, TOKEN_BEGIN_OBJECT) ||
+		last_token == JSON_TOKEN_NAME_SEPARATOR;
+}
+
+/*
+ * Hands out a completed top-level value in multi-document mode and
+ * lets the next one follow. Returns 0 if the callback asked to stop.
+ */
+static int stream_complete(struct json_stream *stream)
+{
+	stream->token.type = JSON_TOKEN_BEGIN;
+	if (stream->callbacks)
+		return 1;
+
+	struct json value = stream->stack->root;
+	stream->stack->root = JSON_NONE;
+	if (stream->document)
+		stream->document->root = value;
+	if (stream->value)
+		return stream->value(stream->user, value);
+	if (!stream->document)
+		json_free(value);
+	return 1;
+}
+
+/* Called whenever a value is complete. */
+static inline int stream_done(struct json_stream *stream)
+{
+	return stream->stack->depth || !stream->multiple ||
+		stream_complete(stream);
+}
+
+/*
+ * Adds a scalar to the values that are built or reports it. Returns 0
+ * if a callback asked to stop or on failure.
+ */
+static int stream_value(struct json_stream *stream, struct json value)
+{
+	const struct json_stream_callbacks *callbacks = stream->callbacks;
+	int proceed = 1;
+
+	if (!callbacks)
+		return json_stack_add(stream->stack, value) &&
+			stream_done(stream);
+
+	switch (JSON_TYPEOF(value)) {
+	case JSON_TYPE_NUMBER:
+		if (callbacks->number)
+			proceed = callbacks->number(stream->user,
+						    JSON_NUMVAL(value));
+		break;
+	case JSON_TYPE_BOOLEAN:
+		if (callbacks->boolean)
+			proceed = callbacks->boolean(stream->user,
+						     JSON_BOOLVAL(value));
+		break;
+	default:
+		if (callbacks->null)
+			proceed = callbacks->null(stream->user);
+		break;
+	}
+	return proceed && stream_done(stream);
+}
+
+static int stream_string(struct json_stream *stream,
+			 const char *str, size_t size)
+{
+	int (*report)(void *, const char *, size_t) =
+		stream->state & JSONS_KEY_SEQ ?
+			stream->callbacks->key : stream->callbacks->string;
+	return !report || report(stream->user, str, size);
+}
+
+/*
+ * Decodes the raw body of an escaped string that was just completed
+ * into the buffer of partial strings, in place if it is there already.
+ * Returns 0 if an escape sequence is invalid.
+ */
+static int stream_unescape(struct json_stream *stream, const char **raw,
+			   size_t *size)
+{
+	char *out = stream->partial.buffer;
+	if (*raw != out) {
+		strbuffer_reserve(&stream->partial, *size);
+		out = stream->partial.buffer;
+	}
+	*size = json_unescape_n(out, *raw, *size);
+	*raw = out;
+	return *size != JSON_UNESCAPE_ERROR;
+}
+
+/*
+ * Decodes the raw body of a string that was just completed. Returns
+ * the decoded string, NUL-terminated and allocated like the values of
+ * the stream, or NULL if an escape sequence is invalid.
+ */
+static char *stream_decode(struct json_stream *stream, const char *raw,
+			   size_t *size, int escaped)
+{
+	struct json_arena *arena = stream_arena(stream);
+	char *str = arena ? json_arena_alloc(arena, *size + 1) :
+		emalloc(*size + 1, 1);
+	if (!str)
+		return NULL;
+
+	if (escaped)
+		*size = json_unescape_n(str, raw, *size);
+	else
+		memcpy(str, raw, *size);
+	if (*size == JSON_UNESCAPE_ERROR) {
+		if (!arena)
+			free(str);
+		return NULL;
+	}
+	str[*size] = 0;
+	return str;
+}
+
+/* Reports the opening or closing of a container. */
+static inline int stream_event(struct json_stream *stream,
+			       int (*event)(void *))
+{
+	return !event || event(stream->user);
+}
+
 int json_stream_write_n(struct json_stream *stream,
 			const char *chunk, size_t size)
 {
-	chain_append_n(stream->chain, chunk, size);
-
 	for (size_t i = 0; i < size; ++i)
 	{
 		char c = chunk[i];
 
 		if (stream->state & JSONS_STR_SEQ) {
+			++stream->token.size;
+			/* Escape sequences are only validated here, even when
+			   split across chunks. The string is decoded in one
+			   pass once it is complete, which also checks that
+			   surrogates come in pairs. */
+			if (stream->state & JSONS_STR_HEX_SEQ) {
+				if (json_hex_digit(c) < 0)
+					goto unexpected_token;
+				if (!--stream->hex_digits)
+					stream->state &= ~JSONS_STR_HEX_SEQ;
+				goto success;
+			}
 			if (stream->state & JSONS_STR_ESC_SEQ) {
-				/* Last problem:
-				 * The passed chunk is not editable.
-				 * If it was, there's still the problem with
-				 * replacing two characters with one ...
-				 * The only reasonable solution to this would
-				 * be replacing a sequence inside the chain.
-				 */
 				stream->state &= ~JSONS_STR_ESC_SEQ;
 				switch (c) {
 				case '\\':
 				case '"':
-				case '/': break;
-				case 'b': c = '\b'; break;
-				case 'f': c = '\f'; break;
-				case 'n': c = '\n'; break;
-				case 'r': c = '\r'; break;
-				case 't': c = '\t'; break;
+				case '/':
+				case 'b':
+				case 'f':
+				case 'n':
+				case 'r':
+				case 't': break;
+				case 'u':
+					stream->state |= JSONS_STR_HEX_SEQ;
+					stream->hex_digits = 4;
+					break;
 				default:
 					goto unexpected_token;
 				}
-				++stream->token.size;
 				goto success;
 			}
+			/* A sequence must not be cut off by an escape
+			   sequence or the end of the string. */
+			if ((c == '\\' || c == '"') && stream->validate_utf8 &&
+					!json_utf8_complete(&stream->utf8))
+				goto unexpected_token;
 			if (c == '\\') {
-				stream->state |= JSONS_STR_ESC_SEQ;
+				stream->state |= JSONS_STR_ESC_SEQ |
+						 JSONS_STR_ESCAPED;
 				goto success;
 			}
-			++stream->token.size;
 			if (c == '"') {
 				size_t position = stream->token.position + 1;
 				size_t size = stream->token.size - 2;
-				char *str = chain_report(stream->chain, position, size);
-				json_stack_push(stream->stack, (struct json){
-					.type = JSON_TYPE_STRING,
-					.value.string = str
-				});
-				stream->stack->top->ready = 1;
-				stream->state &= ~JSONS_STR_SEQ;
-			}
-			goto success;
-		}
+				int escaped = stream->state & JSONS_STR_ESCAPED;
+				stream->state &= ~(JSONS_STR_SEQ | JSONS_STR_ESCAPED);
 
-		if (stream->state & JSONS_NUM_SEQ) {
-			if (stream->state & JSONS_NUM_WAS_EXP) {
-				stream->state &= ~JSONS_NUM_WAS_EXP;
-				if (c == TOKEN_MINUS)
-					stream->state |= JSONS_NUM_EXP_NEG;
-				if (c == TOKEN_PLUS || c == TOKEN_MINUS) {
-					++stream->token.size;
-					goto success;
+				/* A string that began in an earlier chunk was
+				   kept up to where that chunk ended. */
+				const char *raw = chunk + i - size;
+				if (position < stream->position) {
+					strbuffer_appendn(&stream->partial, chunk, i);
+					raw = stream->partial.buffer;
 				}
-			}
-			if (c >= '0' && c <= '9') {
-				int digit = c - '0';
-				if (stream->state & JSONS_NUM_HAS_EXP) {
-					stream->number.exponent *= 10;
-					stream->number.exponent += digit;
+				stream->partial.size = 0;
+
+				if (stream->callbacks) {
+					if (escaped &&
+							!stream_unescape(stream, &raw, &size))
+						goto unexpected_token;
+					if (!stream_string(stream, raw, size) ||
+							!stream_done(stream))
+						goto aborted;
+					goto success;
 				}
-				else if (stream->state & JSONS_NUM_HAS_DOT) {
-					if (stream->number.precision < 16)
-						stream->number.value +=
-							precision_table[++stream->number.precision] * digit;
+
+				/* Interned keys are looked up straight from
+				   the input, the pool keeps its own copy. */
+				if (stream->state & JSONS_KEY_SEQ && stream->keys) {
+					uint32_t hash;
+					if (escaped &&
+							!stream_unescape(stream, &raw, &size))
+						goto unexpected_token;
+					const char *key = json_intern_n(stream->keys,
+						raw, size, &hash);
+					if (!key)
+						goto aborted;
+					json_stack_set_key(stream->stack, (char *)key,
+							   size, hash);
+					goto success;
 				}
-				else {
-					stream->number.value *= 10;
-					stream->number.value += digit;
+
+				char *str = stream_decode(stream, raw, &size, escaped);
+				if (!str)
+					goto unexpected_token;
+				/* Other keys are handed to the object as is. */
+				if (stream->state & JSONS_KEY_SEQ) {
+					json_stack_set_key(stream->stack, str, size, 0);
+					goto success;
 				}
-				++stream->token.size;
-				goto success;
-			}
-			if (!(stream->state & JSONS_NUM_HAS_EXP) &&
-					(c == TOKEN_ELOWER || c == TOKEN_EUPPER)) {
-				stream->state |= (JSONS_NUM_HAS_EXP | JSONS_NUM_WAS_EXP);
-				++stream->token.size;
-				goto success;
-			}
-			if (!(stream->state & JSONS_NUM_HAS_DOT) &&
-					c == TOKEN_DECIMAL_POINT) {
-				stream->state |= JSONS_NUM_HAS_DOT;
-				++stream->token.size;
+				if (!json_stack_add(stream->stack, JSON_STRP(str)) ||
+						!stream_done(stream))
+					goto aborted;
 				goto success;
 			}
+			if ((unsigned char)c < 0x20)
+				goto unexpected_token;
 
-			if (stream->number.exponent) {
-				double factor = 1.0;
-				for (unsigned int i = 0; i < stream->number.exponent; ++i)
-					factor *= 10;
-				if (stream->state & JSONS_NUM_EXP_NEG)
-					factor = 1 / factor;
-				stream->number.value *= factor;
-			}
-			if (stream->state & JSONS_NUM_NEG)
-				stream->number.value *= -1.0;
+			/* Take the rest of the run up to the next quotation
+			 * mark, backslash or control character at once. */
+			size_t run = json_escape_scan(chunk + i + 1, size - i - 1);
+			/* Escape sequences are ASCII and decode to valid
+			   UTF-8, so only the runs are validated, while they
+			   are still in cache. */
+			if (stream->validate_utf8 && !json_utf8_feed(&stream->utf8,
+					chunk + i, run + 1))
+				goto unexpected_token;
+			stream->token.size += run;
+			i += run;
+			goto success;
+		}
 
-			json_stack_push(stream->stack, JSON_NUM(stream->number.value));
-			stream->stack->top->ready = 1;
+		if (stream->state & JSONS_NUM_SEQ) {
+			size_t run = json_number_push_n(&stream->number,
+							chunk + i, size - i);
+			stream->token.size += run;
+			i += run;
+			/* The number may continue in the next chunk. */
+			if (i == size)
+				break;
+			c = chunk[i];
 
-			stream->number.value = 0.0;
-			stream->number.exponent = 0;
-			stream->number.precision = 0;
+			if (!json_number_complete(&stream->number))
+				goto unexpected_token;
 
-			stream->state &= ~(JSONS_NUM_SEQ |
-					   JSONS_NUM_HAS_EXP |
-					   JSONS_NUM_HAS_DOT |
-					   JSONS_NUM_NEG |
-					   JSONS_NUM_EXP_NEG);
+			double value = json_number_value(&stream->number);
+			stream->state &= ~JSONS_NUM_SEQ;
+			if (!stream_value(stream, JSON_NUM(value)))
+				goto aborted;
 		}
 
 		if (stream->state & JSONS_TRUE_SEQ) {
 			if (c != TOKEN_TRUE[stream->token.size])
 				goto unexpected_token;
 			if (stream->token.size >= TOKEN_TRUE_SIZE - 1) {
-				json_stack_push(stream->stack, JSON_BOOL(1));
-				stream->stack->top->ready = 1;
 				stream->state &= ~JSONS_TRUE_SEQ;
+				if (!stream_value(stream, JSON_BOOL(1)))
+					goto aborted;
 			}
 			++stream->token.size;
 			goto success;
@@ -170,9 +404,9 @@ int json_stream_write_n(struct json_stream *stream,
 			if (c != TOKEN_FALSE[stream->token.size])
 				goto unexpected_token;
 			if (stream->token.size >= TOKEN_FALSE_SIZE - 1) {
-				json_stack_push(stream->stack, JSON_BOOL(0));
-				stream->stack->top->ready = 1;
 				stream->state &= ~JSONS_FALSE_SEQ;
+				if (!stream_value(stream, JSON_BOOL(0)))
+					goto aborted;
 			}
 			++stream->token.size;
 			goto success;
@@ -182,9 +416,9 @@ int json_stream_write_n(struct json_stream *stream,
 			if (c != TOKEN_NULL[stream->token.size])
 				goto unexpected_token;
 			if (stream->token.size >= TOKEN_NULL_SIZE - 1) {
-				json_stack_push(stream->stack, JSON_NULL);
-				stream->stack->top->ready = 1;
 				stream->state &= ~JSONS_NULL_SEQ;
+				if (!stream_value(stream, JSON_NULL))
+					goto aborted;
 			}
 			++stream->token.size;
 			goto success;
@@ -199,6 +433,12 @@ int json_stream_write_n(struct json_stream *stream,
 		case TOKEN_LINE_FEED:
 		case TOKEN_HORIZONTAL_TAB:
 			/* Whitespace is not buffered. */
+			stream->token.size = json_token_whitespace(chunk + i, size - i);
+			i += stream->token.size - 1;
+			goto success;
+		case TOKEN_RECORD_SEPARATOR:
+			if (!stream->multiple || stream->stack->depth)
+				goto unexpected_token;
 			stream->token.size = 1;
 			goto success;
 		case TOKEN_END:
@@ -207,9 +447,20 @@ int json_stream_write_n(struct json_stream *stream,
 			/* It's not really necessary to check here, since both
 			   branches return 0. Should be done once the result or
 			   an error message is requested. */
-			struct json_stack_node *top = stream->stack->top;
-			if (!top || !top->ready || top->next)
+			if (stream->stack->depth)
+				goto unexpected_end_of_input;
+			/* Values were handed out as they were completed. */
+			if (stream->multiple)
+				goto end_of_input;
+			if (stream->callbacks) {
+				if (last_token & (JSON_TOKEN_BEGIN | JSON_TOKEN_END))
+					goto unexpected_end_of_input;
+				goto end_of_input;
+			}
+			if (JSON_TYPEOF(stream->stack->root) == JSON_TYPE_NONE)
 				goto unexpected_end_of_input;
+			if (stream->document)
+				stream->document->root = stream->stack->root;
 			goto end_of_input;
 		case TOKEN_BEGIN_ARRAY:
 			if (last_token & ~(JSON_TOKEN_BEGIN |
@@ -217,9 +468,16 @@ int json_stream_write_n(struct json_stream *stream,
 					   JSON_TOKEN_NAME_SEPARATOR |
 					   JSON_TOKEN_VALUE_SEPARATOR))
 				goto unexpected_token;
+			if (!stream_value_allowed(stream, last_token))
+				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_BEGIN_ARRAY;
 			stream->token.size = 1;
-			json_stack_push(stream->stack, JSON_ARR(json_array_new()));
+			if (!stream_open(stream, c))
+				goto unexpected_token;
+			if (stream->callbacks &&
+					!stream_event(stream,
+						      stream->callbacks->begin_array))
+				goto aborted;
 			goto success;
 		case TOKEN_END_ARRAY:
 			if (last_token & (JSON_TOKEN_BEGIN |
@@ -228,9 +486,17 @@ int json_stream_write_n(struct json_stream *stream,
 					  JSON_TOKEN_NAME_SEPARATOR |
 					  JSON_TOKEN_VALUE_SEPARATOR))
 				goto unexpected_token;
+			if (!stream_within(stream, TOKEN_BEGIN_ARRAY))
+				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_END_ARRAY;
 			stream->token.size = 1;
-			json_stack_end_array(stream->stack);
+			json_stack_pop(stream->stack);
+			if (stream->callbacks &&
+					!stream_event(stream,
+						      stream->callbacks->end_array))
+				goto aborted;
+			if (!stream_done(stream))
+				goto aborted;
 			goto success;
 		case TOKEN_BEGIN_OBJECT:
 			if (last_token & ~(JSON_TOKEN_BEGIN |
@@ -238,9 +504,16 @@ int json_stream_write_n(struct json_stream *stream,
 					   JSON_TOKEN_NAME_SEPARATOR |
 					   JSON_TOKEN_VALUE_SEPARATOR))
 				goto unexpected_token;
+			if (!stream_value_allowed(stream, last_token))
+				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_BEGIN_OBJECT;
 			stream->token.size = 1;
-			json_stack_push(stream->stack, JSON_OBJ(json_object_new()));
+			if (!stream_open(stream, c))
+				goto unexpected_token;
+			if (stream->callbacks &&
+					!stream_event(stream,
+						      stream->callbacks->begin_object))
+				goto aborted;
 			goto success;
 		case TOKEN_END_OBJECT:
 			if (last_token & (JSON_TOKEN_BEGIN |
@@ -250,9 +523,18 @@ int json_stream_write_n(struct json_stream *stream,
 					  JSON_TOKEN_VALUE_SEPARATOR/* |
 					  JSON_TOKEN_NAME)*/))
 				goto unexpected_token;
+			if (!stream_within(stream, TOKEN_BEGIN_OBJECT) ||
+					stream->state & JSONS_KEY_SEQ)
+				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_END_OBJECT;
 			stream->token.size = 1;
-			json_stack_end_object(stream->stack);
+			json_stack_pop(stream->stack);
+			if (stream->callbacks &&
+					!stream_event(stream,
+						      stream->callbacks->end_object))
+				goto aborted;
+			if (!stream_done(stream))
+				goto aborted;
 			goto success;
 		case TOKEN_VALUE_SEPARATOR:
 			if (last_token & (JSON_TOKEN_BEGIN |
@@ -262,20 +544,20 @@ int json_stream_write_n(struct json_stream *stream,
 					  JSON_TOKEN_NAME_SEPARATOR |
 					  JSON_TOKEN_VALUE_SEPARATOR))
 				goto unexpected_token;
+			if (!stream->stack->depth || stream->state & JSONS_KEY_SEQ)
+				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_VALUE_SEPARATOR;
 			stream->token.size = 1;
-			if (json_stack_end_array(stream->stack) ||
-					json_stack_end_object(stream->stack))
-				stream->stack->top->ready = 0;
 			goto success;
 		case TOKEN_NAME_SEPARATOR:
 			/* Use JSON_TOKEN_NAME here ... */
 			if (last_token & ~(JSON_TOKEN_STRING))
 				goto unexpected_token;
-			if (!JSON_STACK_SEQUENCE_OK(stream->stack->top))
+			if (!(stream->state & JSONS_KEY_SEQ))
 				goto unexpected_token;
 			stream->token.type = JSON_TOKEN_NAME_SEPARATOR;
 			stream->token.size = 1;
+			stream->state &= ~JSONS_KEY_SEQ;
 			goto success;
 		case TOKEN_QUOTATION_MARK:
 			stream->token.type = JSON_TOKEN_STRING;
@@ -286,19 +568,45 @@ int json_stream_write_n(struct json_stream *stream,
 					   JSON_TOKEN_NAME_SEPARATOR |
 					   JSON_TOKEN_VALUE_SEPARATOR))
 				goto unexpected_token;
+			/* Any other string within an object is a key. */
+			if (stream_within(stream, TOKEN_BEGIN_OBJECT) &&
+					last_token != JSON_TOKEN_NAME_SEPARATOR)
+				stream->state |= JSONS_KEY_SEQ;
 			stream->state |= JSONS_STR_SEQ;
+			json_utf8_init(&stream->utf8);
 			goto success;
 		case 't':
+			if (last_token & ~(JSON_TOKEN_BEGIN |
+					   JSON_TOKEN_BEGIN_ARRAY |
+					   JSON_TOKEN_NAME_SEPARATOR |
+					   JSON_TOKEN_VALUE_SEPARATOR))
+				goto unexpected_token;
+			if (!stream_value_allowed(stream, last_token))
+				goto unexpected_token;
 			stream->state |= JSONS_TRUE_SEQ;
 			stream->token.type = JSON_TOKEN_TRUE;
 			stream->token.size = 1;
 			goto success;
 		case 'f':
+			if (last_token & ~(JSON_TOKEN_BEGIN |
+					   JSON_TOKEN_BEGIN_ARRAY |
+					   JSON_TOKEN_NAME_SEPARATOR |
+					   JSON_TOKEN_VALUE_SEPARATOR))
+				goto unexpected_token;
+			if (!stream_value_allowed(stream, last_token))
+				goto unexpected_token;
 			stream->state |= JSONS_FALSE_SEQ;
 			stream->token.type = JSON_TOKEN_FALSE;
 			stream->token.size = 1;
 			goto success;
 		case 'n':
+			if (last_token & ~(JSON_TOKEN_BEGIN |
+					   JSON_TOKEN_BEGIN_ARRAY |
+					   JSON_TOKEN_NAME_SEPARATOR |
+					   JSON_TOKEN_VALUE_SEPARATOR))
+				goto unexpected_token;
+			if (!stream_value_allowed(stream, last_token))
+				goto unexpected_token;
 			stream->state |= JSONS_NULL_SEQ;
 			stream->token.type = JSON_TOKEN_NULL;
 			stream->token.size = 1;
@@ -310,13 +618,13 @@ int json_stream_write_n(struct json_stream *stream,
 						   JSON_TOKEN_NAME_SEPARATOR |
 						   JSON_TOKEN_VALUE_SEPARATOR))
 					goto unexpected_token;
+				if (!stream_value_allowed(stream, last_token))
+					goto unexpected_token;
 				stream->state |= JSONS_NUM_SEQ;
 				stream->token.type = JSON_TOKEN_NUMBER;
 				stream->token.size = 1;
-				if (c == TOKEN_MINUS)
-					stream->state |= JSONS_NUM_NEG;
-				else
-					stream->number.value += (c - '0');
+				json_number_init(&stream->number);
+				json_number_push(&stream->number, c);
 				goto success;
 			}
 			goto unexpected_token;
@@ -326,11 +634,22 @@ int json_stream_write_n(struct json_stream *stream,
 		continue;
 	}
 
+	/* Keep what the chunk holds of a string that is not complete
+	   yet, everything else that was written is no longer needed. */
+	if (stream->state & JSONS_STR_SEQ) {
+		size_t position = stream->token.position + 1;
+		size_t start = position > stream->position ?
+			position - stream->position : 0;
+		strbuffer_appendn(&stream->partial, chunk + start, size - start);
+	}
+
+	stream->position += size;
 	return 1;
 
 unexpected_token:
 unexpected_end_of_input:
 	printf("Error in JSON string.\n");
 end_of_input:
+aborted:
 	return 0;
 }
@@ -10,37 +10,121 @@
 #include "jonson.h"
 #include "strbuffer.h"
 #include "stack.h"
-#include "chain/chain.h"
 #include "token.h"
+#include "number.h"
+#include "escape.h"
+#include "utf8.h"
 
 enum JSON_STREAM_STATE {
 	JSONS_STR_SEQ     = 0x001, /* String sequence */
 	JSONS_STR_ESC_SEQ = 0x002, /* String escape sequence */
 	JSONS_NUM_SEQ     = 0x004, /* Number sequence */
-	JSONS_NUM_WAS_EXP = 0x008, /* Last character was an E or e */
-	JSONS_NUM_HAS_EXP = 0x010, /* Number contains an E or e */
-	JSONS_NUM_HAS_DOT = 0x020, /* Number contains a decimal point */
-	JSONS_NUM_NEG     = 0x040, /* Number is negative */
-	JSONS_NUM_EXP_NEG = 0x080, /* Number's exponent is negative */
+	JSONS_STR_ESCAPED = 0x008, /* String contains escape sequences */
+	JSONS_KEY_SEQ     = 0x010, /* Object key, until its name separator */
+	JSONS_STR_HEX_SEQ = 0x020, /* Hex digits of a \u escape sequence */
 	JSONS_TRUE_SEQ    = 0x100, /* True sequence */
 	JSONS_FALSE_SEQ   = 0x200, /* False sequence */
 	JSONS_NULL_SEQ    = 0x400  /* Null sequence */
 };
 
+/*
+ * Events reported by a stream instead of building values. Any of them
+ * may be NULL to ignore that kind of event. Returning 0 stops parsing,
+ * in which case json_stream_write_n() returns 0 as well.
+ *
+ * Keys and strings are passed with their escape sequences decoded,
+ * \u escapes and surrogate pairs as UTF-8, and are not NUL-terminated.
+ * They point straight into the written chunk where possible and are
+ * only valid during the call.
+ */
+struct json_stream_callbacks {
+	int (*begin_object)(void *user);
+	int (*end_object)(void *user);
+	int (*begin_array)(void *user);
+	int (*end_array)(void *user);
+	int (*key)(void *user, const char *key, size_t size);
+	int (*string)(void *user, const char *str, size_t size);
+	int (*number)(void *user, double value);
+	int (*boolean)(void *user, int value);
+	int (*null)(void *user);
+};
+
 struct json_stream {
 	unsigned int state;
-	struct chain *chain;
+	size_t position; /* Of the chunk that is being written */
+	const struct json_stream_callbacks *callbacks;
+	int (*value)(void *user, struct json value);
+	int multiple;
+	void *user;
+	struct json_document *document;
+	struct json_intern *keys;
+	struct strbuffer partial; /* Raw bytes of an incomplete string */
 	struct json_stack *stack;
 	struct json_token token;
-	struct {
-		double value;
-		unsigned int exponent;
-		unsigned int precision;
-	} number;
+	int hex_digits; /* Still to come in a \u escape sequence */
+	int validate_utf8;
+	struct json_utf8 utf8; /* Validation state of the current string */
+	struct json_number number;
 };
 
 struct json_stream *json_stream_new(void);
+
+/*
+ * Creates a stream that allocates all parsed values within [document].
+ * Once the end of input is reached, the parsed value is stored as the
+ * root of the document. The document has to outlive the stream.
+ */
+struct json_stream *json_stream_new_in(struct json_document *document);
 void json_stream_free(struct json_stream *stream);
+
+/*
+ * Makes all objects parsed from now on share one copy of each distinct
+ * key. A stream that parses into a document uses the document's pool.
+ * Returns 0 on failure.
+ */
+int json_stream_intern_keys(struct json_stream *stream);
+
+/*
+ * Reports the parsed input to [callbacks] with [user] as their first
+ * argument instead of building values. Has to be called before
+ * anything is written.
+ */
+void json_stream_set_callbacks(struct json_stream *stream,
+			       const struct json_stream_callbacks *callbacks,
+			       void *user);
+
+/*
+ * Limits how deep objects and arrays may be nested, exceeding it is an
+ * error. The default is JSON_STACK_MAX_DEPTH.
+ */
+void json_stream_set_max_depth(struct json_stream *stream, size_t depth);
+
+/*
+ * Rejects strings and keys that are not well-formed UTF-8. Each run of
+ * characters between escape sequences is checked as it is scanned, a
+ * sequence that is cut off at the end of a chunk is completed with the
+ * next one.
+ */
+void json_stream_validate_utf8(struct json_stream *stream);
+
+/*
+ * Accepts any number of top-level values one after another instead of
+ * exactly one, as in newline-delimited JSON, concatenated JSON or
+ * RFC 7464 JSON text sequences, whose record separators are skipped
+ * like whitespace. Each value is passed to [value] as soon as it is
+ * complete, which takes ownership of it. A stream that parses into a
+ * document makes it the root instead, and the callback may reset the
+ * document to reuse its memory for the next value. Returning 0 stops
+ * parsing.
+ *
+ * With event callbacks no values are built and [value] may be NULL.
+ * [user] replaces the one given to json_stream_set_callbacks(). Has to
+ * be called before anything is written.
+ */
+void json_stream_set_multiple(struct json_stream *stream,
+			      int (*value)(void *user, struct json value),
+			      void *user);
+
 int json_stream_write_n(struct json_stream *stream,
 			 const char *chunk, size_t size);
 #define json_stream_write(stream, chunk) \
@@ -0,0 +1,87 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/*
+ * Checks that the parser and the stream decode the same escape
+ * sequences, and that both reject \u0000 instead of cutting the string
+ * short at the NUL it would decode to.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "jonson.h"
+#include "parse.h"
+#include "stream.h"
+
+static const struct {
+	const char *input;
+	const char *output; /* NULL if the input is rejected */
+} cases[] = {
+	{ "\"a\\u0001b\"", "\"a\\u0001b\"" },
+	{ "\"a\\u00e9\\ud83d\\ude00\"", "\"a\xc3\xa9\xf0\x9f\x98\x80\"" },
+	{ "[\"x\\t\\\"y\\\\\",1]", "[\"x\\t\\\"y\\\\\",1]" },
+	{ "{\"k\\n\":\"v\"}", "{\"k\\n\":\"v\"}" },
+	{ "\"a\\u0000b\"", NULL },
+	{ "[\"x\\u0000yz\",1]", NULL },
+	{ "{\"k\\u0000\":1}", NULL },
+	{ "\"\\ud800\"", NULL },
+	{ "\"\\q\"", NULL }
+};
+
+static int failures;
+
+static void check(const char *parser, size_t i, struct json value)
+{
+	char *output = JSON_TYPEOF(value) == JSON_TYPE_NONE ?
+		NULL : json_serialise(value);
+	const char *expected = cases[i].output;
+
+	if ((output == NULL) != (expected == NULL) ||
+			(output && strcmp(output, expected))) {
+		printf("%s: %s gave %s instead of %s\n", parser, cases[i].input,
+		       output ? output : "an error",
+		       expected ? expected : "an error");
+		++failures;
+	}
+	free(output);
+	json_free(value);
+}
+
+static int take_value(void *user, struct json value)
+{
+	*(struct json *)user = value;
+	return 1;
+}
+
+/* Writes the input a byte at a time, so escapes are split up. */
+static struct json stream_parse(const char *input)
+{
+	struct json value = JSON_NONE;
+	struct json_stream *stream = json_stream_new();
+	json_stream_set_multiple(stream, take_value, &value);
+
+	int written = 1;
+	for (size_t i = 0; written && input[i]; ++i)
+		written = json_stream_write_n(stream, input + i, 1);
+	if (!written || !json_stream_write_n(stream, "\n", 1)) {
+		json_free(value);
+		value = JSON_NONE;
+	}
+	json_stream_free(stream);
+	return value;
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		check("parser", i, json_parse(cases[i].input));
+		check("stream", i, stream_parse(cases[i].input));
+	}
+
+	printf("%d failures\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -4,7 +4,131 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+#include <stdint.h>
+#include <string.h>
+
 #include "token.h"
+#include "simd.h"
+
+#if JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define ONES 0x0101010101010101ull
+
+static inline int is_whitespace(char c)
+{
+	return c == TOKEN_SPACE || c == TOKEN_HORIZONTAL_TAB ||
+		c == TOKEN_LINE_FEED || c == TOKEN_CARRIAGE_RETURN;
+}
+
+static inline int is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/*
+ * Portable kernels, skip eight characters at a time while all of them
+ * are spaces, as in indentation, or digits.
+ */
+static size_t whitespace_word(const char *str, size_t size)
+{
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, str + i, 8);
+		if (word != ONES * ' ')
+			break;
+	}
+	while (i < size && is_whitespace(str[i]))
+		++i;
+	return i;
+}
+
+static size_t digits_word(const char *str, size_t size)
+{
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, str + i, 8);
+		/* Every byte is within 0x30 to 0x3f and stays there plus 6. */
+		if ((word & ONES * 0xf0) != ONES * 0x30 ||
+				((word + ONES * 0x06) & ONES * 0xf0) != ONES * 0x30)
+			break;
+	}
+	while (i < size && is_digit(str[i]))
+		++i;
+	return i;
+}
+
+#if JSON_SIMD_X86
+JSON_TARGET("sse2")
+static size_t whitespace_sse2(const char *str, size_t size)
+{
+	const __m128i space = _mm_set1_epi8(TOKEN_SPACE);
+	const __m128i tab = _mm_set1_epi8(TOKEN_HORIZONTAL_TAB);
+	const __m128i line_feed = _mm_set1_epi8(TOKEN_LINE_FEED);
+	const __m128i carriage_return = _mm_set1_epi8(TOKEN_CARRIAGE_RETURN);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		__m128i match = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, space),
+				     _mm_cmpeq_epi8(v, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, line_feed),
+				     _mm_cmpeq_epi8(v, carriage_return)));
+		int mask = ~_mm_movemask_epi8(match) & 0xffff;
+		if (mask)
+			return i + json_ctz32(mask);
+	}
+	return i + whitespace_word(str + i, size - i);
+}
+
+JSON_TARGET("sse2")
+static size_t digits_sse2(const char *str, size_t size)
+{
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		__m128i digit = _mm_sub_epi8(v, zero);
+		__m128i match = _mm_cmpeq_epi8(_mm_max_epu8(digit, nine), nine);
+		int mask = ~_mm_movemask_epi8(match) & 0xffff;
+		if (mask)
+			return i + json_ctz32(mask);
+	}
+	return i + digits_word(str + i, size - i);
+}
+#endif
+
+static size_t whitespace_resolve(const char *str, size_t size);
+static size_t digits_resolve(const char *str, size_t size);
+
+static size_t (*whitespace)(const char *, size_t) = whitespace_resolve;
+static size_t (*digits)(const char *, size_t) = digits_resolve;
+
+static size_t whitespace_resolve(const char *str, size_t size)
+{
+#if JSON_SIMD_X86
+	if (json_simd_level() >= JSON_SIMD_SSE2) {
+		json_dispatch_store(whitespace, whitespace_sse2);
+		json_dispatch_store(digits, digits_sse2);
+		return whitespace_sse2(str, size);
+	}
+#endif
+	json_dispatch_store(whitespace, whitespace_word);
+	json_dispatch_store(digits, digits_word);
+	return whitespace_word(str, size);
+}
+
+static size_t digits_resolve(const char *str, size_t size)
+{
+	whitespace_resolve(str, 0);
+	return json_token_digits(str, size);
+}
 
 void json_token_init(struct json_token *token)
 {
@@ -12,3 +136,13 @@ void json_token_init(struct json_token *token)
 	token->position = 0;
 	token->size = 0;
 }
+
+size_t json_token_whitespace(const char *str, size_t size)
+{
+	return json_dispatch_load(whitespace)(str, size);
+}
+
+size_t json_token_digits(const char *str, size_t size)
+{
+	return json_dispatch_load(digits)(str, size);
+}
@@ -17,6 +17,7 @@
 #define TOKEN_CARRIAGE_RETURN '\r'
 #define TOKEN_LINE_FEED       '\n'
 #define TOKEN_HORIZONTAL_TAB  '\t'
+#define TOKEN_RECORD_SEPARATOR '\x1e'
 
 #define TOKEN_END             '\0'
 #define TOKEN_BEGIN_ARRAY     '['
@@ -66,4 +67,12 @@ struct json_token {
 
 void json_token_init(struct json_token *token);
 
+/*
+ * Return the length of the run of whitespace or decimal digits at the
+ * start of [str], looking at up to [size] characters. Whole words or
+ * vectors are tested at once where possible.
+ */
+size_t json_token_whitespace(const char *str, size_t size);
+size_t json_token_digits(const char *str, size_t size);
+
 #endif /* JONSON_TOKEN_H */
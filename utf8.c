@@ -0,0 +1,330 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "utf8.h"
+#include "simd.h"
+
+#if JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define HIGHS 0x8080808080808080ull
+
+static inline size_t sequence_length(unsigned char lead)
+{
+	return lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+}
+
+/*
+ * Returns the number of bytes at the end of [str] that belong to a
+ * sequence which continues beyond it.
+ */
+static size_t incomplete_tail(const char *str, size_t size)
+{
+	for (size_t k = 1; k <= 3 && k <= size; ++k) {
+		unsigned char c = str[size - k];
+		if (c < 0x80)
+			return 0;
+		if (c >= 0xc0)
+			return sequence_length(c) > k ? k : 0;
+	}
+	return 0;
+}
+
+/*
+ * Portable kernel. Skips eight ASCII bytes at a time and checks each
+ * other sequence against the ranges of RFC 3629.
+ */
+static int valid_word(const char *str, size_t size)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	size_t i = 0;
+
+	while (i < size) {
+		if (i + 8 <= size) {
+			uint64_t word;
+			memcpy(&word, s + i, 8);
+			if (!(word & HIGHS)) {
+				i += 8;
+				continue;
+			}
+		}
+		unsigned char c = s[i];
+		if (c < 0x80) {
+			++i;
+			continue;
+		}
+
+		/* Limits of the second byte, which exclude overlong
+		   forms, surrogates and code points above U+10FFFF. */
+		unsigned char min = 0x80, max = 0xbf;
+		size_t length;
+		if (c >= 0xc2 && c <= 0xdf)
+			length = 2;
+		else if (c >= 0xe0 && c <= 0xef) {
+			length = 3;
+			if (c == 0xe0)
+				min = 0xa0;
+			else if (c == 0xed)
+				max = 0x9f;
+		}
+		else if (c >= 0xf0 && c <= 0xf4) {
+			length = 4;
+			if (c == 0xf0)
+				min = 0x90;
+			else if (c == 0xf4)
+				max = 0x8f;
+		}
+		else
+			return 0;
+
+		if (size - i < length || s[i + 1] < min || s[i + 1] > max)
+			return 0;
+		for (size_t k = 2; k < length; ++k)
+			if ((s[i + k] & 0xc0) != 0x80)
+				return 0;
+		i += length;
+	}
+	return 1;
+}
+
+#if JSON_SIMD_X86
+/*
+ * The vectorised kernels look up the high and low nibble of each byte
+ * and the high nibble of the byte after it in three tables, and flag
+ * the pair as invalid if all three share a bit. Every bit stands for
+ * one kind of error (Keiser and Lemire, "Validating UTF-8 In Less Than
+ * One Instruction Per Byte"):
+ *
+ *   TOO_SHORT   lead byte not followed by a continuation byte
+ *   TOO_LONG    continuation byte after an ASCII character
+ *   OVERLONG_*  sequence that could have been shorter
+ *   SURROGATE   U+D800 to U+DFFF
+ *   TOO_LARGE*  above U+10FFFF
+ *   TWO_CONTS   continuation byte after a continuation byte
+ *
+ * TWO_CONTS is wrong for the third and fourth byte of a sequence, so it
+ * is flipped there, which also flags those positions if they do not
+ * hold a continuation byte.
+ */
+#define TOO_SHORT      0x01
+#define TOO_LONG       0x02
+#define OVERLONG_3     0x04
+#define TOO_LARGE      0x08
+#define SURROGATE      0x10
+#define OVERLONG_2     0x20
+#define TOO_LARGE_1000 0x40
+#define OVERLONG_4     0x40
+#define TWO_CONTS      0x80
+#define CARRY          (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define B(bits) ((char)(bits))
+#define BYTE_1_HIGH \
+	B(TOO_LONG), B(TOO_LONG), B(TOO_LONG), B(TOO_LONG), \
+	B(TOO_LONG), B(TOO_LONG), B(TOO_LONG), B(TOO_LONG), \
+	B(TWO_CONTS), B(TWO_CONTS), B(TWO_CONTS), B(TWO_CONTS), \
+	B(TOO_SHORT | OVERLONG_2), \
+	B(TOO_SHORT), \
+	B(TOO_SHORT | OVERLONG_3 | SURROGATE), \
+	B(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4)
+#define BYTE_1_LOW \
+	B(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4), \
+	B(CARRY | OVERLONG_2), \
+	B(CARRY), B(CARRY), \
+	B(CARRY | TOO_LARGE), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000), \
+	B(CARRY | TOO_LARGE | TOO_LARGE_1000)
+#define BYTE_2_HIGH \
+	B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT), \
+	B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT), \
+	B(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | \
+	  TOO_LARGE_1000 | OVERLONG_4), \
+	B(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE), \
+	B(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE), \
+	B(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE), \
+	B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT), B(TOO_SHORT)
+
+/* A vector ends within a sequence if one of these is exceeded. */
+#define INCOMPLETE_LIMITS \
+	_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, \
+		      B(0xf0 - 1), B(0xe0 - 1), B(0xc0 - 1))
+
+/* The vector formed by the last [n] bytes of [previous] and [input]. */
+#define PREVIOUS_SSE(input, previous, n) \
+	_mm_alignr_epi8(input, previous, 16 - (n))
+#define PREVIOUS_AVX2(input, previous, n) \
+	_mm256_alignr_epi8(input, \
+		_mm256_permute2x128_si256(previous, input, 0x21), 16 - (n))
+
+JSON_TARGET("sse4.2")
+static __m128i check_sse42(__m128i input, __m128i previous)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	__m128i prev1 = PREVIOUS_SSE(input, previous, 1);
+	__m128i prev2 = PREVIOUS_SSE(input, previous, 2);
+	__m128i prev3 = PREVIOUS_SSE(input, previous, 3);
+
+	__m128i special = _mm_and_si128(_mm_and_si128(
+		_mm_shuffle_epi8(_mm_setr_epi8(BYTE_1_HIGH),
+			_mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+		_mm_shuffle_epi8(_mm_setr_epi8(BYTE_1_LOW),
+			_mm_and_si128(prev1, nibble))),
+		_mm_shuffle_epi8(_mm_setr_epi8(BYTE_2_HIGH),
+			_mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+	/* Third and fourth bytes of a sequence. */
+	__m128i must_continue = _mm_and_si128(_mm_or_si128(
+		_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+		_mm_subs_epu8(prev3, _mm_set1_epi8(B(0xf0 - 0x80)))),
+		_mm_set1_epi8(B(0x80)));
+	return _mm_xor_si128(must_continue, special);
+}
+
+JSON_TARGET("sse4.2")
+static int valid_sse42(const char *str, size_t size)
+{
+	const __m128i limits = INCOMPLETE_LIMITS;
+	__m128i previous = _mm_setzero_si128();
+	__m128i incomplete = _mm_setzero_si128();
+	__m128i error = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i input = _mm_loadu_si128((const __m128i *)(str + i));
+		if (!_mm_movemask_epi8(input)) {
+			error = _mm_or_si128(error, incomplete);
+			incomplete = _mm_setzero_si128();
+		}
+		else {
+			error = _mm_or_si128(error, check_sse42(input, previous));
+			incomplete = _mm_subs_epu8(input, limits);
+		}
+		previous = input;
+	}
+	if (!_mm_testz_si128(error, error))
+		return 0;
+
+	/* The rest starts with the sequence the last vector cut off. */
+	i -= incomplete_tail(str, i);
+	return valid_word(str + i, size - i);
+}
+
+JSON_TARGET("avx2")
+static __m256i check_avx2(__m256i input, __m256i previous)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i prev1 = PREVIOUS_AVX2(input, previous, 1);
+	__m256i prev2 = PREVIOUS_AVX2(input, previous, 2);
+	__m256i prev3 = PREVIOUS_AVX2(input, previous, 3);
+
+	__m256i special = _mm256_and_si256(_mm256_and_si256(
+		_mm256_shuffle_epi8(_mm256_setr_epi8(BYTE_1_HIGH, BYTE_1_HIGH),
+			_mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+		_mm256_shuffle_epi8(_mm256_setr_epi8(BYTE_1_LOW, BYTE_1_LOW),
+			_mm256_and_si256(prev1, nibble))),
+		_mm256_shuffle_epi8(_mm256_setr_epi8(BYTE_2_HIGH, BYTE_2_HIGH),
+			_mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+	__m256i must_continue = _mm256_and_si256(_mm256_or_si256(
+		_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+		_mm256_subs_epu8(prev3, _mm256_set1_epi8(B(0xf0 - 0x80)))),
+		_mm256_set1_epi8(B(0x80)));
+	return _mm256_xor_si256(must_continue, special);
+}
+
+JSON_TARGET("avx2")
+static int valid_avx2(const char *str, size_t size)
+{
+	const __m256i limits = _mm256_inserti128_si256(
+		_mm256_set1_epi8(-1), INCOMPLETE_LIMITS, 1);
+	__m256i previous = _mm256_setzero_si256();
+	__m256i incomplete = _mm256_setzero_si256();
+	__m256i error = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i input = _mm256_loadu_si256((const __m256i *)(str + i));
+		if (!_mm256_movemask_epi8(input)) {
+			error = _mm256_or_si256(error, incomplete);
+			incomplete = _mm256_setzero_si256();
+		}
+		else {
+			error = _mm256_or_si256(error,
+						check_avx2(input, previous));
+			incomplete = _mm256_subs_epu8(input, limits);
+		}
+		previous = input;
+	}
+	if (!_mm256_testz_si256(error, error))
+		return 0;
+
+	i -= incomplete_tail(str, i);
+	return valid_sse42(str + i, size - i);
+}
+#endif
+
+static int valid_resolve(const char *str, size_t size);
+
+static int (*valid)(const char *, size_t) = valid_resolve;
+
+static int valid_resolve(const char *str, size_t size)
+{
+	switch (json_simd_level()) {
+#if JSON_SIMD_X86
+	case JSON_SIMD_AVX2: json_dispatch_store(valid, valid_avx2); break;
+	case JSON_SIMD_SSE42: json_dispatch_store(valid, valid_sse42); break;
+#endif
+	default: json_dispatch_store(valid, valid_word); break;
+	}
+	return json_utf8_valid_n(str, size);
+}
+
+int json_utf8_valid_n(const char *str, size_t size)
+{
+	return json_dispatch_load(valid)(str, size);
+}
+
+int json_utf8_feed(struct json_utf8 *utf8, const char *str, size_t size)
+{
+	/* Complete the sequence the previous piece ended with first. */
+	if (utf8->pending_size) {
+		size_t length = sequence_length(utf8->pending[0]);
+		size_t missing = length - utf8->pending_size;
+		if (missing > size)
+			missing = size;
+		memcpy(utf8->pending + utf8->pending_size, str, missing);
+		utf8->pending_size += missing;
+		str += missing;
+		size -= missing;
+		if (utf8->pending_size < length)
+			return 1;
+		if (!json_utf8_valid_n((const char *)utf8->pending, length))
+			return 0;
+		utf8->pending_size = 0;
+	}
+
+	/* Pieces shorter than a vector, as most strings of a stream are,
+	   are not worth setting up the vectorised kernels for. */
+	size_t tail = incomplete_tail(str, size);
+	size_t body = size - tail;
+	if (!(body < 32 ? valid_word(str, body) : json_utf8_valid_n(str, body)))
+		return 0;
+	memcpy(utf8->pending, str + size - tail, tail);
+	utf8->pending_size = tail;
+	return 1;
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * Jonson is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef JONSON_UTF8_H
+#define JONSON_UTF8_H
+
+#include <stddef.h>
+
+/*
+ * Returns 1 if [str] is well-formed UTF-8, i.e. has no overlong forms,
+ * surrogates, code points above U+10FFFF or truncated sequences.
+ * Runs of ASCII are skipped a vector at a time.
+ */
+int json_utf8_valid_n(const char *str, size_t size);
+
+/*
+ * Validation state for input that arrives in pieces. Up to three bytes
+ * of a sequence that is cut off at the end of a piece are kept until
+ * the next one completes it.
+ */
+struct json_utf8 {
+	unsigned char pending[4];
+	size_t pending_size;
+};
+
+static inline void json_utf8_init(struct json_utf8 *utf8)
+{
+	utf8->pending_size = 0;
+}
+
+/*
+ * Validates the next [size] bytes of the input. Returns 0 once it is
+ * known to be invalid.
+ */
+int json_utf8_feed(struct json_utf8 *utf8, const char *str, size_t size);
+
+/*
+ * Returns 1 if the input fed so far does not end within a sequence.
+ */
+static inline int json_utf8_complete(const struct json_utf8 *utf8)
+{
+	return utf8->pending_size == 0;
+}
+
+#endif /* JONSON_UTF8_H */